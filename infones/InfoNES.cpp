@@ -90,6 +90,27 @@ BYTE *ROMBANK[4];
 /* PPU RAM */
 BYTE PPURAM[PPURAM_SIZE];
 
+/* Name table RAM and the mask of its 1KB pages */
+BYTE *PPU_NameRam;
+BYTE PPU_NameRamMask;
+
+/* Palettes of the tiles in PPU_NameRam ( a word per row of tiles,
+   2 bits per 2 tiles, kept by writes to the attribute tables ) */
+DWORD PPU_AttrRows[4][32];
+
+/* CHR-RAM and the mask of its 1KB pages */
+BYTE *PPU_ChrRam;
+BYTE PPU_ChrRamMask;
+
+/* Bytes of PPURAM in use */
+DWORD PPU_RamUsed;
+
+/* Palette RAM */
+BYTE PPU_PalRam[PALRAM_SIZE];
+
+/* Entries of PalTable to pack again from PPU_PalRam ( bit mask ) */
+DWORD PPU_PalDirty;
+
 /* VROM */
 BYTE *VROM;
 
@@ -149,8 +170,23 @@ BYTE *PPU_SP_Base;
 /* Sprite Height */
 WORD PPU_SP_Height;
 
-/* Sprite #0 Scanline Hit Position */
-int SpriteJustHit;
+/* Generation counters of PPU memory writes */
+WORD PPU_VramRowGen[16][32];
+WORD PPU_ChrGen;
+WORD PPU_PalGen;
+
+/* Fingerprints of the scanlines rendered in the last frame ( 0: invalid ) */
+DWORD PPU_LineHash[NES_DISP_HEIGHT];
+
+/* Raster split : PPU states of the spans of the current scanline */
+struct PPU_Split_tag PPU_Split[PPU_SPLIT_MAX];
+int PPU_SplitCnt;
+
+/* CPU clocks at the start of the current scanline */
+WORD PPU_LineClocks;
+
+/* Line buffer to render the spans of a split scanline */
+DWORD PPU_SplitLine[NES_DISP_WIDTH];
 
 /* VRAM Write Enable ( 0: Disable, 1: Enable ) */
 BYTE byVramWriteEnable;
@@ -161,10 +197,6 @@ BYTE PPU_Latch_Flag;
 /* Up and Down Clipping Flag ( 0: non-clip, 1: clip ) */
 BYTE PPU_UpDown_Clip;
 
-/* Frame IRQ ( 0: Disabled, 1: Enabled )*/
-BYTE FrameIRQ_Enable;
-WORD FrameStep;
-
 /*-------------------------------------------------------------------*/
 /*  Display and Others resouces                                      */
 /*-------------------------------------------------------------------*/
@@ -173,20 +205,42 @@ WORD FrameStep;
 WORD FrameSkip;
 WORD FrameCnt;
 
+/* Adaptive Frame Skip ( 0: Disabled, 1: Enabled ) */
+BYTE AutoFrameSkip = 0;
+DWORD SkippedFrames;
+
+/* Time at the last V-Blank and the delay from the real time [us] */
+DWORD AutoSkipPeriod = FRAME_TIME_US;
+DWORD AutoSkipTime;
+int AutoSkipDelay;
+bool AutoSkipping;
+
+/* Dirty Scanline Detection ( 0: Disabled, 1: Enabled ) */
+BYTE DirtyLine_Enable = 0;
+
+/* Line Pipeline ( 0: Disabled, 1: Enabled ) and whether the ROM uses it */
+BYTE LinePipeline_Enable = 0;
+bool PPU_LinePipeline = false;
+
 /* Display Buffer */
-#if 0
-WORD DoubleFrame[ 2 ][ NES_DISP_WIDTH * NES_DISP_HEIGHT ];
-WORD *WorkFrame;
-WORD WorkFrameIdx;
-#else
-//WORD WorkFrame[ NES_DISP_WIDTH * NES_DISP_HEIGHT ];
-WORD *WorkLine = nullptr;
-void __not_in_flash_func(InfoNES_SetLineBuffer)(WORD *p, WORD size)
+#if INFONES_FULL_FRAME
+alignas(4) BYTE DoubleFrame[2][NES_DISP_WIDTH * NES_DISP_HEIGHT * PIXEL_MAX_SIZE];
+BYTE *WorkFrame;
+BYTE WorkFrameIdx;
+#endif
+bool FullFrame_Enable = false;
+
+/* Rendered scanlines ( PPU_DrawTop <= line < PPU_DrawBottom ) */
+BYTE PPU_DrawTop = 4;
+BYTE PPU_DrawBottom = NES_DISP_HEIGHT - 4;
+
+void *WorkLine = nullptr;
+void __not_in_flash_func(InfoNES_SetLineBuffer)(void *p, WORD size)
 {
+  // size : The number of pixels in the line buffer
   assert(size >= NES_DISP_WIDTH);
   WorkLine = p;
 }
-#endif
 
 /* Character Buffer */
 BYTE ChrBuf[256 * 2 * 8 * 8];
@@ -194,8 +248,21 @@ BYTE ChrBuf[256 * 2 * 8 * 8];
 /* Update flag for ChrBuf */
 BYTE ChrBufUpdate;
 
-/* Palette Table */
-WORD PalTable[32];
+/* Palette Table ( packed in the pixel format ) */
+DWORD PalTable[32];
+
+/* Pixel format of the line buffer and the bytes of a pixel */
+BYTE PPU_PixelFormat = PIXEL_DEFAULT;
+BYTE PPU_PixelSize = 2;
+
+/* NES colors packed in the pixel format ( a bank per color emphasis ) */
+DWORD PixelLUT[8][64];
+
+/* Greyscale and color emphasis bits of PPU_R1 the palette table is for */
+BYTE PPU_ColorMode;
+
+/* Flag of a transparent background pixel in the pixel format */
+DWORD PixelBgClear;
 
 /* Table for Mirroring */
 BYTE PPU_MirrorTable[][4] =
@@ -248,6 +315,9 @@ void (*MapperPPU)(WORD wAddr); // mapper 96だけ？
 /* Callback at Rendering Screen 1:BG, 0:Sprite */
 void (*MapperRenderScreen)(BYTE byMode);
 
+/* Hooks of the mapper called by the scanline renderer */
+BYTE PPU_MapperHooks;
+
 /*-------------------------------------------------------------------*/
 /*  ROM information                                                  */
 /*-------------------------------------------------------------------*/
@@ -266,6 +336,8 @@ BYTE ROM_SRAM;
 BYTE ROM_Trainer;
 /* Four screen VRAM  */
 BYTE ROM_FourScr;
+/* CRC32 of PRG and CHR ROM */
+DWORD ROM_Crc32;
 
 /*===================================================================*/
 /*                                                                   */
@@ -285,6 +357,9 @@ void InfoNES_Init()
   // Initialize 6502
   K6502_Init();
 
+  // Pack NES colors in the pixel format
+  InfoNES_SetPixelFormat(PPU_PixelFormat);
+
   // Initialize Scanline Table
   for (nIdx = 0; nIdx < 263; ++nIdx)
   {
@@ -380,6 +455,10 @@ int InfoNES_Reset()
 
   int nIdx;
 
+  // Finish the scanlines of the previous ROM
+  InfoNES_SyncLines();
+  PPU_LinePipeline = false;
+
   /*-------------------------------------------------------------------*/
   /*  Get information on the cassette                                  */
   /*-------------------------------------------------------------------*/
@@ -410,13 +489,18 @@ int InfoNES_Reset()
   // Clear RAM
   InfoNES_MemorySet(RAM, 0, sizeof RAM);
 
-  // Reset frame skip and frame count
-  FrameSkip = 0;
+  // Reset frame count ( FrameSkip is set by the system )
   FrameCnt = 0;
 
-#if 0
+  // Reset adaptive frame skip
+  SkippedFrames = 0;
+  AutoSkipTime = InfoNES_GetMicroSec();
+  AutoSkipDelay = 0;
+  AutoSkipping = false;
+
+#if INFONES_FULL_FRAME
   // Reset work frame
-  WorkFrame = DoubleFrame[ 0 ];
+  WorkFrame = DoubleFrame[0];
   WorkFrameIdx = 0;
 #endif
 
@@ -437,8 +521,15 @@ int InfoNES_Reset()
   /*  Initialize PPU                                                   */
   /*-------------------------------------------------------------------*/
 
+  // Allocate the name tables and CHR-RAM
+  if (InfoNES_SetupPPURAM() < 0)
+    return -1;
+
   InfoNES_SetupPPU();
 
+  // Identify the ROM and select the PPU engine for it
+  InfoNES_DotReset();
+
   /*-------------------------------------------------------------------*/
   /*  Initialize pAPU                                                  */
   /*-------------------------------------------------------------------*/
@@ -466,6 +557,13 @@ int InfoNES_Reset()
   // Set up a mapper initialization function
   MapperTable[nIdx].pMapperInit();
 
+  // Select the renderer for the hooks of the mapper
+  PPU_MapperHooks = (MapperPPU != Map0_PPU ? MAPPER_HOOK_PPU : 0) |
+                    (MapperRenderScreen != Map0_RenderScreen ? MAPPER_HOOK_RENDER : 0);
+
+  // Queue the scanlines to the system unless the mapper or the dot engine renders them
+  PPU_LinePipeline = LinePipeline_Enable && !PPU_MapperHooks && !PPU_DotEngine;
+
   /*-------------------------------------------------------------------*/
   /*  Reset CPU                                                        */
   /*-------------------------------------------------------------------*/
@@ -476,6 +574,134 @@ int InfoNES_Reset()
   return 0;
 }
 
+/*===================================================================*/
+/*                                                                   */
+/*                 InfoNES_Crc32() : Calculate CRC32                 */
+/*                                                                   */
+/*===================================================================*/
+DWORD InfoNES_Crc32(const BYTE *pbyData, DWORD dwSize, DWORD dwCrc)
+{
+  /*
+ *  Calculate CRC32 ( the same as zip )
+ *
+ *  Parameters
+ *    const BYTE *pbyData       (Read)
+ *      Data
+ *    DWORD dwSize              (Read)
+ *      Size of the data
+ *    DWORD dwCrc               (Read)
+ *      CRC32 of the preceding data ( 0 at first )
+ *
+ *  Return values
+ *    CRC32
+ */
+
+  static const DWORD dwTable[16] = {
+      0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+      0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+      0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+      0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c};
+
+  dwCrc = ~dwCrc & 0xffffffff;
+  while (dwSize--)
+  {
+    dwCrc ^= *pbyData++;
+    dwCrc = (dwCrc >> 4) ^ dwTable[dwCrc & 15];
+    dwCrc = (dwCrc >> 4) ^ dwTable[dwCrc & 15];
+  }
+  return ~dwCrc & 0xffffffff;
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*        InfoNES_SetupPPURAM() : Allocate name tables and CHR-RAM   */
+/*                                                                   */
+/*===================================================================*/
+int InfoNES_SetupPPURAM()
+{
+  /*
+ *  Allocate name tables and CHR-RAM from PPURAM
+ *
+ *  Return values
+ *     0 : Normally
+ *    -1 : PPURAM is too small for the cassette
+ *
+ *  Remarks
+ *    CHR-RAM is sized by the NES 2.0 header. For iNES headers, it is
+ *    8KB without VROM, or sized by the mapper. The build sizes PPURAM
+ *    for the largest CHR-RAM it supports ( PPURAM_SIZE ).
+ */
+
+  DWORD dwChrRamSize;
+
+  if ((NesHeader.byInfo2 & 0x0c) == 0x08)
+  {
+    // NES 2.0 : 64 << n bytes of CHR-RAM and battery-backed CHR-RAM
+    int nShift = NesHeader.byReserve[3] & 0x0f;
+    if ((NesHeader.byReserve[3] >> 4) > nShift)
+      nShift = NesHeader.byReserve[3] >> 4;
+    dwChrRamSize = nShift ? 64 << nShift : 0;
+  }
+  else
+  {
+    switch (MapperNo)
+    {
+    case 13: /* CPROM */
+      dwChrRamSize = 0x4000;
+      break;
+    case 96: /* Oeka Kids */
+      dwChrRamSize = 0x8000;
+      break;
+    case 74: /* VROM and CHR-RAM */
+    case 119:
+    case 245:
+      dwChrRamSize = 0x2000;
+      break;
+    default:
+      dwChrRamSize = NesHeader.byVRomSize ? 0 : 0x2000;
+      break;
+    }
+  }
+
+  // In pages of 1KB
+  if (dwChrRamSize && dwChrRamSize < 0x400)
+    dwChrRamSize = 0x400;
+
+  // The pattern tables have to be somewhere
+  if (!dwChrRamSize && !NesHeader.byVRomSize)
+  {
+    InfoNES_MessageBox("Neither VROM nor CHR-RAM is in the cassette.\n");
+    return -1;
+  }
+
+  DWORD dwNameRamSize = ROM_FourScr ? 0x1000 : 0x800;
+
+  if (dwNameRamSize + dwChrRamSize > PPURAM_SIZE)
+  {
+    InfoNES_MessageBox("CHR-RAM of %dKB is unsupported.\n", (int)(dwChrRamSize >> 10));
+    return -1;
+  }
+
+  PPU_NameRam = PPURAM;
+  PPU_NameRamMask = (dwNameRamSize >> 10) - 1;
+
+  if (dwChrRamSize)
+  {
+    PPU_ChrRam = PPURAM + dwNameRamSize;
+    PPU_ChrRamMask = (dwChrRamSize >> 10) - 1;
+  }
+  else
+  {
+    // No CHR-RAM : the pages are read from VROM ( not written )
+    PPU_ChrRam = VROM;
+    PPU_ChrRamMask = 7;
+  }
+
+  PPU_RamUsed = dwNameRamSize + dwChrRamSize;
+
+  return 0;
+}
+
 /*===================================================================*/
 /*                                                                   */
 /*                InfoNES_SetupPPU() : Initialize PPU                */
@@ -490,21 +716,23 @@ void InfoNES_SetupPPU()
   int nPage;
 
   // Clear PPU and Sprite Memory
-  InfoNES_MemorySet(PPURAM, 0, sizeof PPURAM);
+  InfoNES_MemorySet(PPURAM, 0, PPU_RamUsed);
+  InfoNES_MemorySet(PPU_AttrRows, 0, sizeof PPU_AttrRows);
+  InfoNES_MemorySet(PPU_PalRam, 0, sizeof PPU_PalRam);
   InfoNES_MemorySet(SPRRAM, 0, sizeof SPRRAM);
 
   // Reset PPU Register
   PPU_R0 = PPU_R1 = PPU_R2 = PPU_R3 = PPU_R7 = 0;
 
+  // Palette table without greyscale and color emphasis
+  InfoNES_SetColorMode(PPU_R1);
+
   // Reset latch flag
   PPU_Latch_Flag = 0;
 
   // Reset up and down clipping flag
   PPU_UpDown_Clip = 0;
 
-  FrameStep = 0;
-  FrameIRQ_Enable = 0;
-
   // Reset Scroll values
   // PPU_Scr_V = PPU_Scr_V_Next = PPU_Scr_V_Byte = PPU_Scr_V_Byte_Next = PPU_Scr_V_Bit = PPU_Scr_V_Bit_Next = 0;
   // PPU_Scr_H = PPU_Scr_H_Next = PPU_Scr_H_Byte = PPU_Scr_H_Byte_Next = PPU_Scr_H_Bit = PPU_Scr_H_Bit_Next = 0;
@@ -518,8 +746,11 @@ void InfoNES_SetupPPU()
   // Reset scanline
   PPU_Scanline = 0;
 
-  // Reset hit position of sprite #0
-  SpriteJustHit = 0;
+  // Forget the scanlines of the last frame
+  InfoNES_MemorySet(PPU_LineHash, 0, sizeof PPU_LineHash);
+
+  // Reset raster splits
+  PPU_SplitCnt = 0;
 
   // Reset information on PPU_R0
   PPU_Increment = 1;
@@ -529,8 +760,8 @@ void InfoNES_SetupPPU()
   PPU_SP_Height = 8;
 
   // Reset PPU banks
-  for (nPage = 0; nPage < 16; ++nPage)
-    PPUBANK[nPage] = &PPURAM[nPage * 0x400];
+  for (nPage = 0; nPage < 8; ++nPage)
+    PPUBANK[nPage] = &PPU_ChrRam[(nPage & PPU_ChrRamMask) * 0x400];
 
   /* Mirroring of Name Table */
   InfoNES_Mirroring(ROM_Mirroring);
@@ -539,6 +770,78 @@ void InfoNES_SetupPPU()
   byVramWriteEnable = (NesHeader.byVRomSize == 0) ? 1 : 0;
 }
 
+/*===================================================================*/
+/*                                                                   */
+/*   InfoNES_WriteAttr() : Keep the palettes of tiles for a write    */
+/*                                                                   */
+/*===================================================================*/
+void InfoNES_WriteAttr(const BYTE *pbyPage, int nOfs, BYTE byData)
+{
+  /*
+ *  Keep PPU_AttrRows for a write to an attribute table
+ *
+ *  Parameters
+ *    const BYTE *pbyPage      (Read)
+ *      The 1KB page of the name table
+ *    int nOfs                 (Read)
+ *      Offset of the attribute byte ( 0x00 - 0x3f )
+ *    BYTE byData              (Read)
+ *      The attribute byte
+ *
+ *  Remarks
+ *    An attribute byte covers 4x4 tiles. Its upper 2 rows of tiles
+ *    take the lower nibble, and the lower 2 rows the upper nibble.
+ */
+
+  int nPage = (pbyPage - PPU_NameRam) >> 10;
+  if (pbyPage < PPU_NameRam || nPage > PPU_NameRamMask)
+    return;
+
+  int nShift = (nOfs & 7) * 4;
+  DWORD *pdwRow = &PPU_AttrRows[nPage][(nOfs >> 3) * 4];
+  for (int nRow = 0; nRow < 4; ++nRow)
+  {
+    DWORD dwPalettes = (nRow & 2) ? byData >> 4 : byData & 0xf;
+    pdwRow[nRow] = (pdwRow[nRow] & ~(0xfu << nShift)) | (dwPalettes << nShift);
+  }
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*      InfoNES_GetAttrRow() : Get the palettes of a row of tiles    */
+/*                                                                   */
+/*===================================================================*/
+DWORD __not_in_flash_func(InfoNES_GetAttrRow)(const BYTE *pbyPage, int nY)
+{
+  /*
+ *  Get the palettes of a row of tiles in a name table
+ *
+ *  Parameters
+ *    const BYTE *pbyPage      (Read)
+ *      The 1KB page of the name table
+ *    int nY                   (Read)
+ *      Row of tiles ( 0 - 31 )
+ *
+ *  Return values
+ *    2 bits of palette per 2 tiles, the tile nX at bit ( nX & 30 )
+ *
+ *  Remarks
+ *    Name tables out of PPU_NameRam ( in VROM, ... ) are decoded from
+ *    the attribute table.
+ */
+
+  int nPage = (pbyPage - PPU_NameRam) >> 10;
+  if (pbyPage >= PPU_NameRam && nPage <= PPU_NameRamMask)
+    return PPU_AttrRows[nPage][nY];
+
+  const BYTE *pbyAttr = pbyPage + 0x3c0 + (nY >> 2) * 8;
+  int nShift = (nY & 2) << 1;
+  DWORD dwRow = 0;
+  for (int nIdx = 0; nIdx < 8; ++nIdx)
+    dwRow |= (DWORD)((pbyAttr[nIdx] >> nShift) & 0xf) << (nIdx * 4);
+  return dwRow;
+}
+
 /*===================================================================*/
 /*                                                                   */
 /*       InfoNES_Mirroring() : Set up a Mirroring of Name Table      */
@@ -558,12 +861,254 @@ void InfoNES_Mirroring(int nType)
  *        3 : One Screen 0x2000
  *        4 : Four Screen
  *        5 : Special for Mapper #233
+ *
+ *  Remarks
+ *    A four screen cassette keeps four screens whatever the mapper
+ *    sets. 0x3000 - 0x3eff are the mirror of the name tables.
+ */
+
+  if (ROM_FourScr)
+    nType = 4;
+
+  for (int nIdx = 0; nIdx < 4; ++nIdx)
+  {
+    BYTE byPage = (PPU_MirrorTable[nType][nIdx] - NAME_TABLE0) & PPU_NameRamMask;
+    PPUBANK[NAME_TABLE0 + nIdx] = PPUBANK[NAME_TABLE0 + nIdx + 4] = &PPU_NameRam[byPage * 0x400];
+  }
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*     InfoNES_SetPixelFormat() : Set the pixel format of lines      */
+/*                                                                   */
+/*===================================================================*/
+template <class Format>
+static void InfoNES_SetupPixelLUT()
+{
+  for (int nBank = 0; nBank < 8; ++nBank)
+    for (int nColor = 0; nColor < 64; ++nColor)
+      PixelLUT[nBank][nColor] = Format::pack(nColor, InfoNES_EmphasizeColor(NesPalette[nColor], nBank));
+  PixelBgClear = Format::BG_CLEAR;
+  PPU_PixelSize = sizeof(typename Format::Pixel);
+}
+
+bool InfoNES_SetPixelFormat(int nFormat)
+{
+  /*
+ *  Set the pixel format of the line buffer
+ *
+ *  Parameters
+ *    int nFormat          (Read)
+ *      PIXEL_RGB444, PIXEL_RGB565, PIXEL_XRGB8888 or PIXEL_INDEX8
+ *      ( It has to be included in PIXEL_FORMATS )
+ *
+ *  Return values
+ *    true  : Succeeded
+ *    false : The format is not compiled in, the current one is kept
+ *
+ *  Remarks
+ *    NesPalette is given in RGB555.
+ *    The palette table is packed again in the new format.
+ */
+
+  if (nFormat < 0 || nFormat > PIXEL_INDEX8 || !(PIXEL_FORMATS & (1 << nFormat)))
+    return false;
+
+  InfoNES_SyncLines();
+
+  switch (nFormat)
+  {
+  case PIXEL_RGB444:
+    InfoNES_SetupPixelLUT<PixelRGB444>();
+    break;
+  case PIXEL_RGB565:
+    InfoNES_SetupPixelLUT<PixelRGB565>();
+    break;
+  case PIXEL_XRGB8888:
+    InfoNES_SetupPixelLUT<PixelXRGB8888>();
+    break;
+  case PIXEL_INDEX8:
+    InfoNES_SetupPixelLUT<PixelIndex8>();
+    break;
+  }
+  PPU_PixelFormat = nFormat;
+
+  // Palette table
+  InfoNES_SetColorMode(PPU_ColorMode);
+  ++PPU_PalGen;
+  return true;
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*     InfoNES_SetFullFrame() : Enable the full-frame render target  */
+/*                                                                   */
+/*===================================================================*/
+bool InfoNES_SetFullFrame(bool bEnable, bool bAllLines)
+{
+  /*
+ *  Enable the full-frame render target
+ *
+ *  Parameters
+ *    bool bEnable         (Read)
+ *      true : Render into DoubleFrame, false : Into the system's lines
+ *    bool bAllLines       (Read)
+ *      true : Render all 240 scanlines, false : Skip 4 lines at the
+ *      top and the bottom as TVs hide them
+ *
+ *  Return values
+ *    true  : Succeeded
+ *    false : The full-frame target is not compiled in
+ *
+ *  Remarks
+ *    Without the target, InfoNES_PreDrawLine() gets all the lines.
+ *    Rows of the frame are NES_DISP_WIDTH pixels in PPU_PixelFormat.
+ */
+
+#if !INFONES_FULL_FRAME
+  if (bEnable)
+    return false;
+#endif
+
+  FullFrame_Enable = bEnable;
+  PPU_DrawTop = bAllLines ? 0 : 4;
+  PPU_DrawBottom = bAllLines ? NES_DISP_HEIGHT : NES_DISP_HEIGHT - 4;
+
+  // The last frame is not in the target
+  InfoNES_MemorySet(PPU_LineHash, 0, sizeof PPU_LineHash);
+  return true;
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*     InfoNES_GetFrame() : Get the last frame rendered              */
+/*                                                                   */
+/*===================================================================*/
+const void *InfoNES_GetFrame(int *pnPitch)
+{
+  /*
+ *  Get the last frame rendered in the full-frame target
+ *
+ *  Parameters
+ *    int *pnPitch         (Write)
+ *      Bytes from a row to the next one
+ *
+ *  Return values
+ *    The front buffer, or nullptr without the full-frame target
+ *
+ *  Remarks
+ *    The frame is swapped at SCAN_UNKNOWN_START, just before
+ *    InfoNES_LoadFrame(), and stays unchanged until the next one.
+ *    It is not a copy, so take it in InfoNES_LoadFrame() before the
+ *    next frame is finished.
+ */
+
+  if (pnPitch)
+    *pnPitch = NES_DISP_WIDTH * PPU_PixelSize;
+
+#if INFONES_FULL_FRAME
+  if (FullFrame_Enable)
+    return DoubleFrame[1 - WorkFrameIdx];
+#endif
+  return nullptr;
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*     InfoNES_SetColorMode() : Set greyscale and color emphasis     */
+/*                                                                   */
+/*===================================================================*/
+void __not_in_flash_func(InfoNES_SetColorMode)(BYTE byR1)
+{
+  /*
+ *  Set greyscale and color emphasis of the palette table
+ *
+ *  Parameters
+ *    BYTE byR1                 (Read)
+ *      The value of PPU_R1 ( R1_BACKCOLOR and R1_MONOCHROME are used )
+ *
+ *  Remarks
+ *    The palette table is packed again from the bank of PixelLUT,
+ *    so the renderer pays nothing per pixel.
+ */
+
+  PPU_ColorMode = byR1 & (R1_BACKCOLOR | R1_MONOCHROME);
+
+  for (int nIdx = 0; nIdx < 32; ++nIdx)
+  {
+    PalTable[nIdx] = (nIdx & 3) ? InfoNES_PackColor(PPU_PalRam[nIdx])
+                                : InfoNES_PackColor(PPU_PalRam[0]) | PixelBgClear;
+  }
+  PPU_PalDirty = 0;
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*     InfoNES_UpdatePalette() : Pack the palette entries written    */
+/*                                                                   */
+/*===================================================================*/
+void __not_in_flash_func(InfoNES_UpdatePalette)()
+{
+  /*
+ *  Pack the palette entries written since the last scanline
+ *
+ *  Remarks
+ *    Writes to 0x3f00 - 0x3fff only store PPU_PalRam and mark
+ *    PPU_PalDirty. The backdrop at 0x00 is shared by the 8 entries
+ *    of color 0.
+ */
+
+  DWORD dwDirty = PPU_PalDirty;
+  PPU_PalDirty = 0;
+
+  while (dwDirty)
+  {
+    int nIdx = __builtin_ctz(dwDirty);
+    dwDirty &= dwDirty - 1;
+    PalTable[nIdx] = (nIdx & 3) ? InfoNES_PackColor(PPU_PalRam[nIdx])
+                                : InfoNES_PackColor(PPU_PalRam[0]) | PixelBgClear;
+  }
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*         InfoNES_EmphasizeColor() : Apply color emphasis           */
+/*                                                                   */
+/*===================================================================*/
+WORD InfoNES_EmphasizeColor(WORD wRGB555, int nEmphasis)
+{
+  /*
+ *  Apply color emphasis to a NES color
+ *
+ *  Parameters
+ *    WORD wRGB555              (Read)
+ *      The color in RGB555
+ *    int nEmphasis             (Read)
+ *      The emphasis bits of PPU_R1 >> 5 ( 1:Red, 2:Green, 4:Blue )
+ *
+ *  Return values
+ *    The color in RGB555
+ *
+ *  Remarks
+ *    The components not emphasized are attenuated to 3/4.
  */
 
-  PPUBANK[NAME_TABLE0] = &PPURAM[PPU_MirrorTable[nType][0] * 0x400];
-  PPUBANK[NAME_TABLE1] = &PPURAM[PPU_MirrorTable[nType][1] * 0x400];
-  PPUBANK[NAME_TABLE2] = &PPURAM[PPU_MirrorTable[nType][2] * 0x400];
-  PPUBANK[NAME_TABLE3] = &PPURAM[PPU_MirrorTable[nType][3] * 0x400];
+  static const BYTE byAttenuate[8] = {0, 6, 5, 7, 3, 7, 7, 7};
+
+  int nR = (wRGB555 >> 10) & 31;
+  int nG = (wRGB555 >> 5) & 31;
+  int nB = wRGB555 & 31;
+
+  // Bit 0:Red, 1:Green, 2:Blue
+  int nMask = byAttenuate[nEmphasis & 7];
+  if (nMask & 1)
+    nR = nR * 3 >> 2;
+  if (nMask & 2)
+    nG = nG * 3 >> 2;
+  if (nMask & 4)
+    nB = nB * 3 >> 2;
+
+  return (nR << 10) | (nG << 5) | nB;
 }
 
 /*===================================================================*/
@@ -621,19 +1166,31 @@ void __not_in_flash_func(InfoNES_Cycle)()
   {
     util::WorkMeterMark(MARKER_START);
 
+    // Origin of the dots of raster splits
+    PPU_LineClocks = getCurrentClocks();
+
     // Set a flag if a scanning line is a hit in the sprite #0
-    if (SpriteJustHit == PPU_Scanline &&
+    // ( the dot engine sets it by itself )
+    int nHitX = -1;
+    if (!PPU_DotEngine &&
+        !(PPU_R2 & R2_HIT_SP) &&
+        (PPU_R1 & R1_SHOW_SP) && (PPU_R1 & R1_SHOW_SCR) &&
         PPU_ScanTable[PPU_Scanline] == SCAN_ON_SCREEN)
+    {
+      nHitX = InfoNES_GetSprHitX();
+    }
+
+    if (nHitX >= 0)
     {
       // # of Steps to execute before sprite #0 hit
-      int nStep = SPRRAM[SPR_X] * STEP_PER_SCANLINE / NES_DISP_WIDTH;
+      // ( rounded up, so a write after the hit is split after the dot )
+      int nStep = (nHitX + DOTS_PER_STEP - 1) / DOTS_PER_STEP;
 
       // Execute instructions
       K6502_Step(nStep);
 
       // Set a sprite hit flag
-      if ((PPU_R1 & R1_SHOW_SP) && (PPU_R1 & R1_SHOW_SCR))
-        PPU_R2 |= R2_HIT_SP;
+      PPU_R2 |= R2_HIT_SP;
 
       // NMI is required if there is necessity
       if ((PPU_R0 & R0_NMI_SP) && (PPU_R1 & R1_SHOW_SP))
@@ -642,19 +1199,24 @@ void __not_in_flash_func(InfoNES_Cycle)()
       // Execute instructions
       K6502_Step(STEP_PER_SCANLINE - nStep);
     }
-    else
+    else if (PPU_DotEngine && (PPU_MapperHooks & MAPPER_HOOK_PPU))
     {
+      // Run the PPU through the sprite fetches ( dot 257 - ), so an IRQ
+      // of the mapper watching them ( MMC3 ) is raised in the scanline
+      int nStep = DOT_SPRITE_FETCH / DOTS_PER_STEP;
+
       // Execute instructions
-      K6502_Step(STEP_PER_SCANLINE);
-    }
+      K6502_Step(nStep);
+
+      InfoNES_DotCatchUp();
 
-    // Frame IRQ in H-Sync
-    FrameStep += STEP_PER_SCANLINE;
-    if (FrameStep > STEP_PER_FRAME && FrameIRQ_Enable)
+      // Execute instructions
+      K6502_Step(STEP_PER_SCANLINE - nStep);
+    }
+    else
     {
-      FrameStep %= STEP_PER_FRAME;
-      IRQ_REQ;
-      APU_Reg[0x4015] |= 0x40;
+      // Execute instructions
+      K6502_Step(STEP_PER_SCANLINE);
     }
 
     util::WorkMeterMark(MARKER_CPU);
@@ -671,6 +1233,168 @@ void __not_in_flash_func(InfoNES_Cycle)()
   }
 }
 
+/*===================================================================*/
+/*                                                                   */
+/*    InfoNES_ReuseScanline() : Put the pixels of the last frame     */
+/*                                                                   */
+/*===================================================================*/
+static bool __not_in_flash_func(InfoNES_ReuseScanline)()
+{
+  /*
+ *  Put the pixels of the scanline in the last frame again
+ *
+ *  Return values
+ *    true  : The pixels were put in the line buffer
+ *    false : The scanline has to be rendered
+ *
+ *  Remarks
+ *    The full-frame target copies the row from the front buffer,
+ *    which holds the last rendered frame.
+ */
+
+#if INFONES_FULL_FRAME
+  if (FullFrame_Enable)
+  {
+    int nPitch = NES_DISP_WIDTH * PPU_PixelSize;
+    InfoNES_MemoryCopy(WorkLine,
+                       &DoubleFrame[1 - WorkFrameIdx][PPU_Scanline * nPitch],
+                       nPitch);
+    return true;
+  }
+#endif
+  return InfoNES_ReuseLine(PPU_Scanline);
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*    InfoNES_SkipCleanLine() : Skip a scanline unchanged since      */
+/*                              the last frame                       */
+/*                                                                   */
+/*===================================================================*/
+static bool __not_in_flash_func(InfoNES_SkipCleanLine)()
+{
+  /*
+ *  Skip a scanline unchanged since the last frame
+ *
+ *  Return values
+ *    true  : The last frame's pixels were reused
+ *    false : The scanline has to be rendered
+ *
+ *  Remarks
+ *    Mappers hooking the rendering ( MMC2, MMC4, MMC5, ... ) switch
+ *    banks while a scanline is drawn, so they are always rendered.
+ */
+
+  if (!DirtyLine_Enable ||
+      PPU_MapperHooks)
+    return false;
+
+  // A split scanline is not in the fingerprint
+  if (PPU_SplitCnt)
+  {
+    PPU_LineHash[PPU_Scanline] = 0;
+    return false;
+  }
+
+  int nSprCnt;
+  DWORD dwHash = InfoNES_LineHash(&nSprCnt);
+  DWORD &dwPrevHash = PPU_LineHash[PPU_Scanline];
+
+  if (dwHash == dwPrevHash && InfoNES_ReuseScanline())
+  {
+    // Set the sprite flag as InfoNES_DrawLine() does
+    if (PPU_R1 & R1_SHOW_SP)
+    {
+      PPU_R2 &= ~R2_MAX_SP;
+      if (nSprCnt >= 8)
+        PPU_R2 |= R2_MAX_SP;
+    }
+    return true;
+  }
+
+  dwPrevHash = dwHash;
+  return false;
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*   InfoNES_StatusLine() : Update PPU status of an undrawn line     */
+/*                                                                   */
+/*===================================================================*/
+static void __not_in_flash_func(InfoNES_StatusLine)()
+{
+  /*
+ *  Update PPU status of a scanline which is not rendered
+ *
+ *  Remarks
+ *    Called for the lines of skipped frames, the border lines out of
+ *    PPU_DrawTop - PPU_DrawBottom and the queued lines of the line
+ *    pipeline. Sets the sprite overflow flag as InfoNES_DrawLine()
+ *    does without touching any pixel. Sprite #0 hit is handled by
+ *    InfoNES_Cycle() on every visible line regardless.
+ */
+
+  if (!(PPU_R1 & R1_SHOW_SP))
+    return;
+
+  // Only the 8th sprite on the scanline matters
+  int nSprCnt = 0;
+  for (const BYTE *pSPRRAM = SPRRAM; pSPRRAM < SPRRAM + SPRRAM_SIZE; pSPRRAM += 4)
+  {
+    // Unsigned, so sprites below the scanline wrap to large rows
+    unsigned nRow = PPU_Scanline - 1 - pSPRRAM[SPR_Y];
+    if (nRow < (unsigned)PPU_SP_Height && ++nSprCnt >= 8)
+      break;
+  }
+
+  PPU_R2 &= ~R2_MAX_SP;
+  if (nSprCnt >= 8)
+    PPU_R2 |= R2_MAX_SP;
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*    InfoNES_AutoFrameSkip() : Decide to skip the next frame        */
+/*                                                                   */
+/*===================================================================*/
+static void __not_in_flash_func(InfoNES_AutoFrameSkip)()
+{
+  /*
+ *  Decide to skip the next frame
+ *
+ *  Remarks
+ *    The delay from the display is accumulated from the time of
+ *    every frame against AutoSkipPeriod. A system paced by a display
+ *    slower than the NES sets its period, or every frame would count
+ *    as late. Being ahead is not kept, as the system waits for the
+ *    display anyway. Skipping starts at AUTOSKIP_ON_US of delay
+ *    and lasts until it drops to AUTOSKIP_OFF_US, drawing at least
+ *    one frame in every AUTOSKIP_MAX + 1 frames.
+ */
+
+  DWORD dwTime = InfoNES_GetMicroSec();
+  int nPeriod = (int)AutoSkipPeriod;
+  AutoSkipDelay += (int)(dwTime - AutoSkipTime) - nPeriod;
+  AutoSkipTime = dwTime;
+
+  if (AutoSkipDelay < 0)
+    AutoSkipDelay = 0;
+  else if (AutoSkipDelay > nPeriod * (AUTOSKIP_MAX + 1))
+    AutoSkipDelay = nPeriod * (AUTOSKIP_MAX + 1);
+
+  AutoSkipping = AutoSkipDelay > (AutoSkipping ? AUTOSKIP_OFF_US : AUTOSKIP_ON_US);
+
+  if (AutoSkipping && FrameCnt < AUTOSKIP_MAX)
+  {
+    ++FrameCnt;
+    ++SkippedFrames;
+  }
+  else
+  {
+    FrameCnt = 0;
+  }
+}
+
 /*===================================================================*/
 /*                                                                   */
 /*              InfoNES_HSync() : A function in H-Sync               */
@@ -699,17 +1423,60 @@ int __not_in_flash_func(InfoNES_HSync)()
   /*-------------------------------------------------------------------*/
   /*  Render a scanline                                                */
   /*-------------------------------------------------------------------*/
-  if (FrameCnt == 0 &&
-      PPU_ScanTable[PPU_Scanline] == SCAN_ON_SCREEN)
+  if (PPU_DotEngine)
   {
-    if (PPU_Scanline >= 4 && PPU_Scanline < 240 - 4)
+    // The rest of the scanline
+    InfoNES_DotHSync();
+  }
+
+  if (PPU_ScanTable[PPU_Scanline] == SCAN_ON_SCREEN)
+  {
+    if (FrameCnt == 0 &&
+        PPU_Scanline >= PPU_DrawTop && PPU_Scanline < PPU_DrawBottom)
     {
-      InfoNES_PreDrawLine(PPU_Scanline);
-      InfoNES_DrawLine();
-      InfoNES_PostDrawLine(PPU_Scanline);
+      // Greyscale, color emphasis and palette writes of the scanline
+      if ((PPU_R1 ^ PPU_ColorMode) & (R1_BACKCOLOR | R1_MONOCHROME))
+      {
+        InfoNES_SyncLines();
+        InfoNES_SetColorMode(PPU_R1);
+      }
+      else if (PPU_PalDirty)
+      {
+        InfoNES_SyncLines();
+        InfoNES_UpdatePalette();
+      }
+
+      if (PPU_LinePipeline && !FullFrame_Enable)
+      {
+        // Queue the PPU state of the scanline, the system renders it
+        struct PPU_Line_tag *pLine = InfoNES_GetLineRecord(PPU_Scanline);
+        InfoNES_GetLineState(pLine, true);
+        InfoNES_QueueLine(pLine);
+        InfoNES_StatusLine();
+      }
+      else
+      {
+#if INFONES_FULL_FRAME
+        if (FullFrame_Enable)
+          WorkLine = &WorkFrame[PPU_Scanline * NES_DISP_WIDTH * PPU_PixelSize];
+        else
+#endif
+          InfoNES_PreDrawLine(PPU_Scanline);
+        if (PPU_DotEngine)
+          InfoNES_DotDrawLine();
+        else if (!InfoNES_SkipCleanLine())
+          InfoNES_DrawLine();
+        if (!FullFrame_Enable)
+          InfoNES_PostDrawLine(PPU_Scanline);
+      }
+    }
+    else if (!PPU_DotEngine)
+    {
+      // Skipped frame or hidden border line, only the status flags
+      InfoNES_StatusLine();
     }
-    // todo: 描画しないラインにもスプライトオーバーレジスタとかは反映する必要がある
   }
+  PPU_SplitCnt = 0;
 
   util::WorkMeterReset(); // 計測起点はここ
 
@@ -725,7 +1492,9 @@ int __not_in_flash_func(InfoNES_HSync)()
   //PPU_Scr_H_Byte = PPU_Scr_H_Byte_Next;
   //PPU_Scr_H_Bit = PPU_Scr_H_Bit_Next;
 
-  if ((PPU_R1 & R1_SHOW_SP) || (PPU_R1 & R1_SHOW_SCR))
+  // ( the dot engine scrolls by itself )
+  if (!PPU_DotEngine &&
+      ((PPU_R1 & R1_SHOW_SP) || (PPU_R1 & R1_SHOW_SCR)))
   {
     if (PPU_Scanline == SCAN_VBLANK_END)
     {
@@ -770,28 +1539,28 @@ int __not_in_flash_func(InfoNES_HSync)()
     // Set up a character data
     if (NesHeader.byVRomSize == 0 && FrameCnt == 0)
       InfoNES_SetupChr();
-
-    // Get position of sprite #0
-    InfoNES_GetSprHitY();
     break;
 
   case SCAN_UNKNOWN_START:
     if (FrameCnt == 0)
     {
+#if INFONES_FULL_FRAME
+      // Switching of the double buffer
+      WorkFrameIdx = 1 - WorkFrameIdx;
+      WorkFrame = DoubleFrame[WorkFrameIdx];
+#endif
+
       // Transfer the contents of work frame on the screen
       InfoNES_LoadFrame();
-
-#if 0
-        // Switching of the double buffer
-        WorkFrameIdx = 1 - WorkFrameIdx;
-        WorkFrame = DoubleFrame[ WorkFrameIdx ];
-#endif
     }
     break;
 
   case SCAN_VBLANK_START:
     // FrameCnt + 1
-    FrameCnt = (FrameCnt >= FrameSkip) ? 0 : FrameCnt + 1;
+    if (AutoFrameSkip)
+      InfoNES_AutoFrameSkip();
+    else
+      FrameCnt = (FrameCnt >= FrameSkip) ? 0 : FrameCnt + 1;
 
     // Set a V-Blank flag
     PPU_R2 |= R2_IN_VBLANK;
@@ -821,20 +1590,69 @@ int __not_in_flash_func(InfoNES_HSync)()
     if (PAD_PUSH(PAD_System, PAD_SYS_QUIT))
       return -1; // Exit an emulation
 
-    break;
-  }
+    break;
+  }
+
+  // Successful
+  return 0;
+}
+
+//#pragma GCC optimize("O2")
+
+namespace
+{
+  /*
+   *  Tables of a sprite row
+   *
+   *    byReverse : Bits of a byte in the reverse order ( H-flip )
+   *    dwExpand  : Two planes of 4 dots ( plane 0 in bits 0-3, plane 1
+   *                in bits 4-7 ) to 4 bytes of 2 bit pixels, the
+   *                left end first in little endian
+   *
+   *  Not const, so that they are in RAM as the sprites read them.
+   */
+  struct SpriteTables
+  {
+    BYTE byReverse[256];
+    uint32_t dwExpand[256];
+
+    constexpr SpriteTables() : byReverse(), dwExpand()
+    {
+      for (int nIdx = 0; nIdx < 256; ++nIdx)
+      {
+        for (int nBit = 0; nBit < 8; ++nBit)
+          if (nIdx & (1 << nBit))
+            byReverse[nIdx] |= 0x80 >> nBit;
+
+        for (int nDot = 0; nDot < 4; ++nDot)
+        {
+          uint32_t dwPixel = ((nIdx >> (3 - nDot)) & 1) | (((nIdx >> (7 - nDot)) & 1) << 1);
+          dwExpand[nIdx] |= dwPixel << (nDot * 8);
+        }
+      }
+    }
+  };
+  SpriteTables SprTables = SpriteTables();
+
+  /* Merge 4 dots of a sprite into the sprite buffer */
+  inline void __not_in_flash_func(mergeSprite)(BYTE *pDst, uint32_t dwPixels, uint32_t dwColor)
+  {
+    if (!dwPixels)
+      return;
 
-  // Successful
-  return 0;
-}
+    // 0xff in the bytes of the opaque dots
+    uint32_t dwMask = ((dwPixels | (dwPixels >> 1)) & 0x01010101) * 0xff;
 
-//#pragma GCC optimize("O2")
+    uint32_t dwDst;
+    InfoNES_MemoryCopy(&dwDst, pDst, 4);
+    dwDst = (dwDst & ~dwMask) | ((dwPixels | dwColor) & dwMask);
+    InfoNES_MemoryCopy(pDst, &dwDst, 4);
+  }
 
-namespace
-{
-  void __not_in_flash_func(compositeSprite)(const uint16_t *pal,
+  template <class Format>
+  void __not_in_flash_func(compositeSprite)(const DWORD *pal,
                                             const uint8_t *spr,
-                                            uint16_t *buf)
+                                            typename Format::Pixel *buf)
   {
     auto sprEnd = spr + NES_DISP_WIDTH;
     do
@@ -842,7 +1660,7 @@ namespace
       auto proc = [=](int i) __attribute__((always_inline))
       {
         int v = spr[i];
-        if (v && ((v >> 7) || (buf[i] >> 15)))
+        if (v && ((v >> 7) || (buf[i] & Format::BG_CLEAR)))
         {
           buf[i] = pal[v & 0xf];
         }
@@ -864,60 +1682,344 @@ namespace
   }
 }
 
+/*===================================================================*/
+/*                                                                   */
+/*  InfoNES_IsSplitState() : Whether the PPU is in the state of a    */
+/*                           raster split                            */
+/*                                                                   */
+/*===================================================================*/
+static inline bool InfoNES_IsSplitState(const struct PPU_Split_tag *pSplit)
+{
+  if (pSplit->wAddr != PPU_Addr || pSplit->byScrHBit != PPU_Scr_H_Bit ||
+      pSplit->byR0 != PPU_R0 || pSplit->byR1 != PPU_R1)
+    return false;
+
+  for (int nPage = 0; nPage < 12; ++nPage)
+    if (pSplit->pbyBank[nPage] != PPUBANK[nPage])
+      return false;
+
+  return true;
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*     InfoNES_SplitLine() : Record a raster split before a write    */
+/*                           to the PPU                              */
+/*                                                                   */
+/*===================================================================*/
+void __not_in_flash_func(InfoNES_SplitLine)()
+{
+  /*
+ *  Record a raster split before a write to the PPU
+ *
+ *  Remarks
+ *    Called before writes to $2000, $2001, $2005, $2006 and to the
+ *    mapper. The PPU state before the write is kept with the dot the
+ *    CPU has reached in the scanline, DOTS_PER_STEP dots a step as
+ *    the sprite #0 hit is timed. InfoNES_DrawLine() renders the dots
+ *    before it in that state. A write in the H-Blank keeps the whole
+ *    scanline in the state before it, so it shows from the next one.
+ *
+ *    Mappers hooking the rendering ( MMC2, MMC4, MMC5, ... ) are not
+ *    split, as their latches must see a scanline only once.
+ */
+
+  if (PPU_DotEngine || FrameCnt != 0 ||
+      PPU_ScanTable[PPU_Scanline] != SCAN_ON_SCREEN ||
+      PPU_MapperHooks)
+    return;
+
+  int nX = (WORD)(getCurrentClocks() - PPU_LineClocks) * DOTS_PER_STEP;
+  if (nX == 0)
+    return;
+  if (nX > NES_DISP_WIDTH)
+    nX = NES_DISP_WIDTH;
+
+  if (PPU_SplitCnt)
+  {
+    struct PPU_Split_tag *pLast = &PPU_Split[PPU_SplitCnt - 1];
+
+    // The last write did not change the state
+    if (InfoNES_IsSplitState(pLast))
+    {
+      pLast->wEndX = nX;
+      return;
+    }
+
+    // No dots since the last write, or the later writes share the last span
+    if (pLast->wEndX == nX || PPU_SplitCnt == PPU_SPLIT_MAX)
+      return;
+  }
+
+  struct PPU_Split_tag *pSplit = &PPU_Split[PPU_SplitCnt++];
+  pSplit->wEndX = nX;
+  pSplit->wAddr = PPU_Addr;
+  pSplit->byScrHBit = PPU_Scr_H_Bit;
+  pSplit->byR0 = PPU_R0;
+  pSplit->byR1 = PPU_R1;
+  for (int nPage = 0; nPage < 12; ++nPage)
+    pSplit->pbyBank[nPage] = PPUBANK[nPage];
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*    InfoNES_DrawSpans() : Render a scanline in the spans of the    */
+/*                          raster splits                            */
+/*                                                                   */
+/*===================================================================*/
+template <class Format, int Hooks>
+static int __not_in_flash_func(InfoNES_DrawSpans)(const struct PPU_Line_tag &rLine, void *pBuf)
+{
+  /*
+ *  Render a scanline in the spans of the raster splits
+ *
+ *  Remarks
+ *    The last span is rendered in the state of rLine. For the others,
+ *    the whole scanline is rendered in the recorded state to
+ *    PPU_SplitLine and the dots of the span are copied from there.
+ *    After writes in the H-Blank only, the scanline is rendered in
+ *    place in the state before them.
+ */
+
+  typedef typename Format::Pixel Pixel;
+
+  // The last span, empty after a write in the H-Blank
+  int nSprCnt = 0;
+  bool bHBlank = rLine.bySplitCnt && rLine.pSplit[rLine.bySplitCnt - 1].wEndX >= NES_DISP_WIDTH;
+  if (!bHBlank)
+    nSprCnt = InfoNES_DrawLine<Format, Hooks>(rLine, pBuf);
+
+  struct PPU_Line_tag span;
+  span.wLine = rLine.wLine;
+
+  int nStartX = 0;
+  for (int nIdx = 0; nIdx < rLine.bySplitCnt; ++nIdx)
+  {
+    const struct PPU_Split_tag *pSplit = &rLine.pSplit[nIdx];
+
+    span.wAddr = pSplit->wAddr;
+    span.byScrHBit = pSplit->byScrHBit;
+    span.byR0 = pSplit->byR0;
+    span.byR1 = pSplit->byR1;
+    span.ppbyBank = pSplit->pbyBank;
+
+    if (nStartX == 0 && pSplit->wEndX >= NES_DISP_WIDTH)
+    {
+      // A single span of the whole scanline
+      nSprCnt = InfoNES_DrawLine<Format, Hooks>(span, pBuf);
+      break;
+    }
+    int nCnt = InfoNES_DrawLine<Format, Hooks>(span, PPU_SplitLine);
+    if (bHBlank && nIdx == rLine.bySplitCnt - 1)
+      nSprCnt = nCnt;
+
+    InfoNES_MemoryCopy(static_cast<Pixel *>(pBuf) + nStartX,
+                       reinterpret_cast<Pixel *>(PPU_SplitLine) + nStartX,
+                       (pSplit->wEndX - nStartX) * sizeof(Pixel));
+    nStartX = pSplit->wEndX;
+  }
+
+  // The sprite flag is of the last span drawn
+  return nSprCnt;
+}
+
+template <class Format>
+static int __not_in_flash_func(InfoNES_DrawSpans)(const struct PPU_Line_tag &rLine, void *pBuf)
+{
+  // Only the mappers hooking the rendering pay for the calls
+  switch (PPU_MapperHooks)
+  {
+  case 0:
+    return InfoNES_DrawSpans<Format, 0>(rLine, pBuf);
+
+  case MAPPER_HOOK_PPU:
+    return InfoNES_DrawSpans<Format, MAPPER_HOOK_PPU>(rLine, pBuf);
+
+  default:
+    return InfoNES_DrawSpans<Format, MAPPER_HOOK_PPU | MAPPER_HOOK_RENDER>(rLine, pBuf);
+  }
+}
+
+static int __not_in_flash_func(InfoNES_DrawSpans)(const struct PPU_Line_tag &rLine, void *pBuf)
+{
+  // In the pixel format of the line buffer
+  switch (PPU_PixelFormat)
+  {
+#if PIXEL_FORMATS & (1 << PIXEL_RGB444)
+  case PIXEL_RGB444:
+    return InfoNES_DrawSpans<PixelRGB444>(rLine, pBuf);
+#endif
+#if PIXEL_FORMATS & (1 << PIXEL_RGB565)
+  case PIXEL_RGB565:
+    return InfoNES_DrawSpans<PixelRGB565>(rLine, pBuf);
+#endif
+#if PIXEL_FORMATS & (1 << PIXEL_XRGB8888)
+  case PIXEL_XRGB8888:
+    return InfoNES_DrawSpans<PixelXRGB8888>(rLine, pBuf);
+#endif
+#if PIXEL_FORMATS & (1 << PIXEL_INDEX8)
+  case PIXEL_INDEX8:
+    return InfoNES_DrawSpans<PixelIndex8>(rLine, pBuf);
+#endif
+  }
+  return 0;
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*     InfoNES_GetLineState() : Get the PPU state of a scanline      */
+/*                                                                   */
+/*===================================================================*/
+void __not_in_flash_func(InfoNES_GetLineState)(struct PPU_Line_tag *pLine, bool bCopy)
+{
+  /*
+ *  Get the PPU state the current scanline is rendered from
+ *
+ *  Parameters
+ *    struct PPU_Line_tag *pLine  (Write)
+ *      PPU state of the scanline
+ *    bool bCopy                  (Read)
+ *      true  : PPUBANK and the raster splits are copied in pLine
+ *      false : pLine refers to them ( rendered before they change )
+ */
+
+  pLine->wLine = PPU_Scanline;
+  pLine->wAddr = PPU_Addr;
+  pLine->byScrHBit = PPU_Scr_H_Bit;
+  pLine->byR0 = PPU_R0;
+  pLine->byR1 = PPU_R1;
+  pLine->bySplitCnt = PPU_SplitCnt;
+
+  if (bCopy)
+  {
+    InfoNES_MemoryCopy(pLine->pbyBank, PPUBANK, sizeof pLine->pbyBank);
+    InfoNES_MemoryCopy(pLine->Split, PPU_Split, PPU_SplitCnt * sizeof(struct PPU_Split_tag));
+    pLine->ppbyBank = pLine->pbyBank;
+    pLine->pSplit = pLine->Split;
+  }
+  else
+  {
+    pLine->ppbyBank = PPUBANK;
+    pLine->pSplit = PPU_Split;
+  }
+}
+
 /*===================================================================*/
 /*                                                                   */
 /*              InfoNES_DrawLine() : Render a scanline               */
 /*                                                                   */
 /*===================================================================*/
 void __not_in_flash_func(InfoNES_DrawLine)()
+{
+  /*
+ *  Render the current scanline to WorkLine
+ *
+ */
+
+  struct PPU_Line_tag line;
+  InfoNES_GetLineState(&line, false);
+
+  int nSprCnt = InfoNES_DrawSpans(line, WorkLine);
+
+  // Set a flag of maximum sprites on scanline
+  if (PPU_R1 & R1_SHOW_SP)
+  {
+    PPU_R2 &= ~R2_MAX_SP;
+    if (nSprCnt >= 8)
+      PPU_R2 |= R2_MAX_SP;
+  }
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*      InfoNES_RenderLine() : Render a scanline from its record     */
+/*                                                                   */
+/*===================================================================*/
+void __not_in_flash_func(InfoNES_RenderLine)(const struct PPU_Line_tag *pLine, void *pBuf)
+{
+  /*
+ *  Render a scanline queued by InfoNES_QueueLine()
+ *
+ *  Parameters
+ *    const struct PPU_Line_tag *pLine  (Read)
+ *      PPU state of the scanline
+ *    void *pBuf                        (Write)
+ *      Line buffer
+ *
+ *  Remarks
+ *    Called by the renderer of the line pipeline on another core.
+ *    The sprite flag is set by InfoNES_HSync() instead.
+ */
+
+  InfoNES_DrawSpans(*pLine, pBuf);
+}
+
+template <class Format, int Hooks>
+int __not_in_flash_func(InfoNES_DrawLine)(const struct PPU_Line_tag &rLine, void *pBuf)
 {
   /*
  *  Render a scanline
  *
+ *  Parameters
+ *    const struct PPU_Line_tag &rLine  (Read)
+ *      PPU state of the scanline
+ *    void *pBuf                        (Write)
+ *      Line buffer
+ *
+ *  Return values
+ *    The number of sprites on the scanline
+ *
+ *  Remarks
+ *    The pixels are written in Format::Pixel. The palette table is
+ *    already packed in the format by InfoNES_SetPixelFormat().
+ *    Hooks has MAPPER_HOOK_* of the mapper callbacks to be called.
+ *    Only rLine, SPRRAM, PalTable and PPU memory are read, so that
+ *    the line can be rendered on another core.
  */
 
+  typedef typename Format::Pixel Pixel;
+
   int nX;
   int nY;
-  int nY4;
   int nYBit;
-  WORD *pPalTbl;
-  BYTE *pAttrBase;
-  WORD *pPoint;
+  DWORD dwAttrRow;
+  Pixel *pPoint;
   int nNameTable;
   BYTE *pbyNameTable;
-  BYTE *pbyChrData;
   BYTE *pSPRRAM;
   int nAttr;
   int nSprCnt;
-  int nIdx;
-  int nSprData;
   BYTE bySprCol;
   BYTE pSprBuf[NES_DISP_WIDTH + 7];
 
+  const int nSpHeight = (rLine.byR0 & R0_SP_SIZE) ? 16 : 8;
+  nSprCnt = 0;
+
   /*-------------------------------------------------------------------*/
   /*  Render Background                                                */
   /*-------------------------------------------------------------------*/
 
   /* MMC5 VROM switch */
-  MapperRenderScreen(1);
+  if constexpr (Hooks & MAPPER_HOOK_RENDER)
+    MapperRenderScreen(1);
 
   // Pointer to the render position
-  //  pPoint = &WorkFrame[PPU_Scanline * NES_DISP_WIDTH];
-  assert(WorkLine);
-  pPoint = WorkLine;
+  //  pPoint = &WorkFrame[rLine.wLine * NES_DISP_WIDTH];
+  assert(pBuf);
+  pPoint = static_cast<Pixel *>(pBuf);
 
   // Clear a scanline if screen is off
-  if (!(PPU_R1 & R1_SHOW_SCR))
+  if (!(rLine.byR1 & R1_SHOW_SCR))
   {
-    InfoNES_MemorySet(pPoint, 0, NES_DISP_WIDTH << 1);
+    InfoNES_MemorySet(pPoint, Format::BLACK, NES_DISP_WIDTH * sizeof(Pixel));
   }
   else
   {
-    nNameTable = PPU_NameTableBank;
+    nNameTable = NAME_TABLE0 + ((rLine.wAddr >> 10) & 3);
 
 #if 0
-    nY = PPU_Scr_V_Byte + (PPU_Scanline >> 3);
-    nYBit = PPU_Scr_V_Bit + (PPU_Scanline & 7);
+    nY = PPU_Scr_V_Byte + (rLine.wLine >> 3);
+    nYBit = PPU_Scr_V_Bit + (rLine.wLine & 7);
 
     if (nYBit > 7)
     {
@@ -934,47 +2036,52 @@ void __not_in_flash_func(InfoNES_DrawLine)()
       nY -= 30;
     }
 #else
-    nY = (PPU_Addr >> 5) & 31;
-    const int yOfsModBG = PPU_Addr >> 12;
+    nY = (rLine.wAddr >> 5) & 31;
+    const int yOfsModBG = rLine.wAddr >> 12;
     nYBit = yOfsModBG << 3;
 #endif
 
-    nX = PPU_Scr_H_Byte;
-
-    nY4 = ((nY & 2) << 1);
+    nX = (rLine.wAddr & 31);
 
     //
-    const int patternTableIdBG = PPU_R0 & R0_BG_ADDR ? 1 : 0;
+    const int patternTableIdBG = rLine.byR0 & R0_BG_ADDR ? 1 : 0;
     const int bankOfsBG = patternTableIdBG << 2;
 
+    // Callback at PPU read/write with the address of the pattern
+    auto hookPPU = [&](int ch) __attribute__((always_inline))
+    {
+      if constexpr (Hooks & MAPPER_HOOK_PPU)
+        MapperPPU((patternTableIdBG << 12) | (ch << 4) | yOfsModBG);
+    };
+
     /*-------------------------------------------------------------------*/
     /*  Rendering of the block of the left end                           */
     /*-------------------------------------------------------------------*/
 
-    pbyNameTable = PPUBANK[nNameTable] + nY * 32 + nX;
-    pbyChrData = PPU_BG_Base + (*pbyNameTable << 6) + nYBit;
-    pAttrBase = PPUBANK[nNameTable] + 0x3c0 + (nY / 4) * 8;
+    pbyNameTable = rLine.ppbyBank[nNameTable] + nY * 32 + nX;
+    dwAttrRow = InfoNES_GetAttrRow(rLine.ppbyBank[nNameTable], nY);
 #if 0
+    pbyChrData = PPU_BG_Base + (*pbyNameTable << 6) + nYBit;
     pPalTbl = &PalTable[(((pAttrBase[nX >> 2] >> ((nX & 2) + nY4)) & 3) << 2)];
 
-    for (nIdx = PPU_Scr_H_Bit; nIdx < 8; ++nIdx)
+    for (nIdx = rLine.byScrHBit; nIdx < 8; ++nIdx)
     {
       *(pPoint++) = pPalTbl[pbyChrData[nIdx]];
     }
 #else
     {
-      pPoint += 8 - PPU_Scr_H_Bit;
+      pPoint += 8 - rLine.byScrHBit;
 
-      const auto pal = &PalTable[(((pAttrBase[nX >> 2] >> ((nX & 2) + nY4)) & 3) << 2)];
+      const auto pal = &PalTable[((dwAttrRow >> (nX & 30)) & 3) << 2];
       const int ch = *pbyNameTable;
       const int bank = (ch >> 6) + bankOfsBG;
       const int addrOfs = ((ch & 63) << 4) + yOfsModBG;
-      const auto data = PPUBANK[bank] + addrOfs;
+      const auto data = rLine.ppbyBank[bank] + addrOfs;
       const auto pl0 = data[0];
       const auto pl1 = data[8];
       const auto pat0 = (pl0 & 0x55) | ((pl1 << 1) & 0xaa);
       const auto pat1 = ((pl0 >> 1) & 0x55) | (pl1 & 0xaa);
-      switch (PPU_Scr_H_Bit)
+      switch (rLine.byScrHBit)
       {
       case 0:
         pPoint[-8] = pal[(pat1 >> 6) & 3];
@@ -999,7 +2106,7 @@ void __not_in_flash_func(InfoNES_DrawLine)()
 #endif
 
     // Callback at PPU read/write
-    MapperPPU(PATTBL(pbyChrData));
+    hookPPU(*pbyNameTable);
 
     ++nX;
     ++pbyNameTable;
@@ -1010,12 +2117,12 @@ void __not_in_flash_func(InfoNES_DrawLine)()
 
     auto putBG = [&](int nX) __attribute__((always_inline))
     {
-      const auto pal = &PalTable[(((pAttrBase[nX >> 2] >> ((nX & 2) + nY4)) & 3) << 2)];
+      const auto pal = &PalTable[((dwAttrRow >> (nX & 30)) & 3) << 2];
       const auto palAddr = reinterpret_cast<uintptr_t>(pal);
       const int ch = *pbyNameTable;
       const int bank = (ch >> 6) + bankOfsBG;
       const int addrOfs = ((ch & 63) << 4) + yOfsModBG;
-      const auto data = PPUBANK[bank] + addrOfs;
+      const auto data = rLine.ppbyBank[bank] + addrOfs;
       const auto pl0 = data[0];
       const auto pl1 = data[8];
       // const auto pat0 = (pl0 & 0x55) | ((pl1 << 1) & 0xaa);
@@ -1023,8 +2130,9 @@ void __not_in_flash_func(InfoNES_DrawLine)()
       const auto pat0 = ((pl0 & 0x55) << 1) | ((pl1 & 0x55) << 2);
       const auto pat1 = ((pl0 & 0xaa) << 0) | ((pl1 & 0xaa) << 1);
 
+      // ofs : color * 2
       auto readPal = [&](int ofs) {
-        return *reinterpret_cast<const WORD *>(palAddr + ofs);
+        return static_cast<Pixel>(*reinterpret_cast<const DWORD *>(palAddr + ofs * (sizeof(*pal) / 2)));
       };
       pPoint[0] = readPal((pat1 >> 6) & 6);
       pPoint[1] = readPal((pat0 >> 6) & 6);
@@ -1057,7 +2165,7 @@ void __not_in_flash_func(InfoNES_DrawLine)()
 #endif
 
       // Callback at PPU read/write
-      MapperPPU(PATTBL(pbyChrData));
+      hookPPU(*pbyNameTable);
 
       ++pbyNameTable;
     }
@@ -1065,14 +2173,14 @@ void __not_in_flash_func(InfoNES_DrawLine)()
     // Holizontal Mirror
     nNameTable ^= NAME_TABLE_H_MASK;
 
-    pbyNameTable = PPUBANK[nNameTable] + nY * 32;
-    pAttrBase = PPUBANK[nNameTable] + 0x3c0 + (nY / 4) * 8;
+    pbyNameTable = rLine.ppbyBank[nNameTable] + nY * 32;
+    dwAttrRow = InfoNES_GetAttrRow(rLine.ppbyBank[nNameTable], nY);
 
     /*-------------------------------------------------------------------*/
     /*  Rendering of the right table                                     */
     /*-------------------------------------------------------------------*/
 
-    for (nX = 0; nX < PPU_Scr_H_Byte; ++nX)
+    for (nX = 0; nX < (rLine.wAddr & 31); ++nX)
     {
 #if 0
       pbyChrData = PPU_BG_Base + (*pbyNameTable << 6) + nYBit;
@@ -1092,7 +2200,7 @@ void __not_in_flash_func(InfoNES_DrawLine)()
 #endif
 
       // Callback at PPU read/write
-      MapperPPU(PATTBL(pbyChrData));
+      hookPPU(*pbyNameTable);
 
       ++pbyNameTable;
     }
@@ -1104,23 +2212,23 @@ void __not_in_flash_func(InfoNES_DrawLine)()
 #if 0
     pbyChrData = PPU_BG_Base + (*pbyNameTable << 6) + nYBit;
     pPalTbl = &PalTable[(((pAttrBase[nX >> 2] >> ((nX & 2) + nY4)) & 3) << 2)];
-    for (nIdx = 0; nIdx < PPU_Scr_H_Bit; ++nIdx)
+    for (nIdx = 0; nIdx < rLine.byScrHBit; ++nIdx)
     {
       pPoint[nIdx] = pPalTbl[pbyChrData[nIdx]];
     }
 #else
     {
-      const auto pal = &PalTable[(((pAttrBase[nX >> 2] >> ((nX & 2) + nY4)) & 3) << 2)];
+      const auto pal = &PalTable[((dwAttrRow >> (nX & 30)) & 3) << 2];
       const int ch = *pbyNameTable;
       const int bank = (ch >> 6) + bankOfsBG;
       const int addrOfs = ((ch & 63) << 4) + yOfsModBG;
-      const auto data = PPUBANK[bank] + addrOfs;
+      const auto data = rLine.ppbyBank[bank] + addrOfs;
       const auto pl0 = data[0];
       const auto pl1 = data[8];
       const auto pat0 = (pl0 & 0x55) | ((pl1 << 1) & 0xaa);
       const auto pat1 = ((pl0 >> 1) & 0x55) | (pl1 & 0xaa);
       //      const auto [pat0, pat1] = getPatBG(ch);
-      switch (PPU_Scr_H_Bit)
+      switch (rLine.byScrHBit)
       {
       case 8:
         pPoint[7] = pal[(pat0 >> 0) & 3];
@@ -1142,36 +2250,36 @@ void __not_in_flash_func(InfoNES_DrawLine)()
         break;
       }
 
-      //      pPoint += PPU_Scr_H_Bit;
+      //      pPoint += rLine.byScrHBit;
     }
 #endif
 
     // Callback at PPU read/write
-    MapperPPU(PATTBL(pbyChrData));
+    hookPPU(*pbyNameTable);
 
     /*-------------------------------------------------------------------*/
     /*  Backgroud Clipping                                               */
     /*-------------------------------------------------------------------*/
-    if (!(PPU_R1 & R1_CLIP_BG))
+    if (!(rLine.byR1 & R1_CLIP_BG))
     {
-      WORD *pPointTop;
+      Pixel *pPointTop;
 
-      // pPointTop = &WorkFrame[PPU_Scanline * NES_DISP_WIDTH];
-      pPointTop = WorkLine;
-      InfoNES_MemorySet(pPointTop, 0, 8 << 1);
+      // pPointTop = &WorkFrame[rLine.wLine * NES_DISP_WIDTH];
+      pPointTop = static_cast<Pixel *>(pBuf);
+      InfoNES_MemorySet(pPointTop, Format::BLACK, 8 * sizeof(Pixel));
     }
 
     /*-------------------------------------------------------------------*/
     /*  Clear a scanline if up and down clipping flag is set             */
     /*-------------------------------------------------------------------*/
     if (PPU_UpDown_Clip &&
-        (SCAN_ON_SCREEN_START > PPU_Scanline || PPU_Scanline > SCAN_BOTTOM_OFF_SCREEN_START))
+        (SCAN_ON_SCREEN_START > rLine.wLine || rLine.wLine > SCAN_BOTTOM_OFF_SCREEN_START))
     {
-      WORD *pPointTop;
+      Pixel *pPointTop;
 
-      // pPointTop = &WorkFrame[PPU_Scanline * NES_DISP_WIDTH];
-      pPointTop = WorkLine;
-      InfoNES_MemorySet(pPointTop, 0, NES_DISP_WIDTH << 1);
+      // pPointTop = &WorkFrame[rLine.wLine * NES_DISP_WIDTH];
+      pPointTop = static_cast<Pixel *>(pBuf);
+      InfoNES_MemorySet(pPointTop, Format::BLACK, NES_DISP_WIDTH * sizeof(Pixel));
     }
   }
 
@@ -1182,17 +2290,15 @@ void __not_in_flash_func(InfoNES_DrawLine)()
   /*-------------------------------------------------------------------*/
 
   /* MMC5 VROM switch */
-  MapperRenderScreen(0);
+  if constexpr (Hooks & MAPPER_HOOK_RENDER)
+    MapperRenderScreen(0);
 
-  if (PPU_R1 & R1_SHOW_SP)
+  if (rLine.byR1 & R1_SHOW_SP)
   {
-    // Reset Scanline Sprite Count
-    PPU_R2 &= ~R2_MAX_SP;
-
     // Reset sprite buffer
     InfoNES_MemorySet(pSprBuf, 0, sizeof pSprBuf);
 
-    const int patternTableIdSP88 = PPU_R0 & R0_SP_ADDR ? 1 : 0;
+    const int patternTableIdSP88 = rLine.byR0 & R0_SP_ADDR ? 1 : 0;
     const int bankOfsSP88 = patternTableIdSP88 << 2;
 
     // Render a sprite to the sprite buffer
@@ -1200,7 +2306,7 @@ void __not_in_flash_func(InfoNES_DrawLine)()
     for (pSPRRAM = SPRRAM + (63 << 2); pSPRRAM >= SPRRAM; pSPRRAM -= 4)
     {
       nY = pSPRRAM[SPR_Y] + 1;
-      if (nY > PPU_Scanline || nY + PPU_SP_Height <= PPU_Scanline)
+      if (nY > rLine.wLine || nY + nSpHeight <= rLine.wLine)
         continue; // Next sprite
 
       /*-------------------------------------------------------------------*/
@@ -1211,13 +2317,13 @@ void __not_in_flash_func(InfoNES_DrawLine)()
       ++nSprCnt;
 
       nAttr = pSPRRAM[SPR_ATTR];
-      nYBit = PPU_Scanline - nY;
-      nYBit = (nAttr & SPR_ATTR_V_FLIP) ? (PPU_SP_Height - nYBit - 1) : nYBit;
+      nYBit = rLine.wLine - nY;
+      nYBit = (nAttr & SPR_ATTR_V_FLIP) ? (nSpHeight - nYBit - 1) : nYBit;
       const int yOfsModSP = nYBit;
       nYBit <<= 3;
 
 #if 0
-      if (PPU_R0 & R0_SP_SIZE)
+      if (rLine.byR0 & R0_SP_SIZE)
       {
         // Sprite size 8x16
         if (pSPRRAM[SPR_CHR] & 1)
@@ -1283,7 +2389,7 @@ void __not_in_flash_func(InfoNES_DrawLine)()
       int ch = pSPRRAM[SPR_CHR];
 
       int bankOfs;
-      if (PPU_R0 & R0_SP_SIZE)
+      if (rLine.byR0 & R0_SP_SIZE)
       {
         // 8x16
         bankOfs = (ch & 1) << 2;
@@ -1297,98 +2403,32 @@ void __not_in_flash_func(InfoNES_DrawLine)()
 
       const int bank = (ch >> 6) + bankOfs;
       const int addrOfs = ((ch & 63) << 4) + ((yOfsModSP & 8) << 1) + (yOfsModSP & 7);
-      const auto data = PPUBANK[bank] + addrOfs;
-      const uint32_t pl0 = data[0];
-      const uint32_t pl1 = data[8];
-      const auto pat0 = ((pl0 & 0x55) << 24) | ((pl1 & 0x55) << 25);
-      const auto pat1 = ((pl0 & 0xaa) << 23) | ((pl1 & 0xaa) << 24);
+      const auto data = rLine.ppbyBank[bank] + addrOfs;
+      BYTE byPl0 = data[0];
+      BYTE byPl1 = data[8];
 
       nAttr ^= SPR_ATTR_PRI;
       bySprCol = (nAttr & (SPR_ATTR_COLOR | SPR_ATTR_PRI)) << 2;
       nX = pSPRRAM[SPR_X];
-      const auto dst = pSprBuf + nX;
 
       if (nAttr & SPR_ATTR_H_FLIP)
       {
-        // h flip
-        if (int v = (pat1 << 0) >> 30)
-        {
-          dst[7] = bySprCol | v;
-        }
-        if (int v = (pat0 << 0) >> 30)
-        {
-          dst[6] = bySprCol | v;
-        }
-        if (int v = (pat1 << 2) >> 30)
-        {
-          dst[5] = bySprCol | v;
-        }
-        if (int v = (pat0 << 2) >> 30)
-        {
-          dst[4] = bySprCol | v;
-        }
-        if (int v = (pat1 << 4) >> 30)
-        {
-          dst[3] = bySprCol | v;
-        }
-        if (int v = (pat0 << 4) >> 30)
-        {
-          dst[2] = bySprCol | v;
-        }
-        if (int v = (pat1 << 6) >> 30)
-        {
-          dst[1] = bySprCol | v;
-        }
-        if (int v = (pat0 << 6) >> 30)
-        {
-          dst[0] = bySprCol | v;
-        }
-      }
-      else
-      {
-        // non flip
-        if (int v = (pat1 << 0) >> 30)
-        {
-          dst[0] = bySprCol | v;
-        }
-        if (int v = (pat0 << 0) >> 30)
-        {
-          dst[1] = bySprCol | v;
-        }
-        if (int v = (pat1 << 2) >> 30)
-        {
-          dst[2] = bySprCol | v;
-        }
-        if (int v = (pat0 << 2) >> 30)
-        {
-          dst[3] = bySprCol | v;
-        }
-        if (int v = (pat1 << 4) >> 30)
-        {
-          dst[4] = bySprCol | v;
-        }
-        if (int v = (pat0 << 4) >> 30)
-        {
-          dst[5] = bySprCol | v;
-        }
-        if (int v = (pat1 << 6) >> 30)
-        {
-          dst[6] = bySprCol | v;
-        }
-        if (int v = (pat0 << 6) >> 30)
-        {
-          dst[7] = bySprCol | v;
-        }
+        byPl0 = SprTables.byReverse[byPl0];
+        byPl1 = SprTables.byReverse[byPl1];
       }
+
+      const uint32_t dwColor = bySprCol * 0x01010101u;
+      mergeSprite(pSprBuf + nX, SprTables.dwExpand[(byPl0 >> 4) | (byPl1 & 0xf0)], dwColor);
+      mergeSprite(pSprBuf + nX + 4, SprTables.dwExpand[(byPl0 & 0x0f) | ((byPl1 << 4) & 0xf0)], dwColor);
 #endif
     }
 
     // Rendering sprite
-    pPoint = WorkLine;
-    //   pPoint -= (NES_DISP_WIDTH - PPU_Scr_H_Bit);
+    pPoint = static_cast<Pixel *>(pBuf);
+    //   pPoint -= (NES_DISP_WIDTH - rLine.byScrHBit);
 
 #if 1
-    compositeSprite(PalTable + 0x10, pSprBuf, pPoint);
+    compositeSprite<Format>(PalTable + 0x10, pSprBuf, pPoint);
 #else
     {
       const auto *pal = &PalTable[0x10];
@@ -1401,7 +2441,7 @@ void __not_in_flash_func(InfoNES_DrawLine)()
         auto proc = [=](int i) __attribute__((always_inline))
         {
           int v = spr[i];
-          if (v && ((v >> 7) || (pPoint[i] >> 15)))
+          if (v && ((v >> 7) || (pPoint[i] & Format::BG_CLEAR)))
           {
             pPoint[i] = pal[v & 0xf];
           }
@@ -1426,147 +2466,175 @@ void __not_in_flash_func(InfoNES_DrawLine)()
     /*-------------------------------------------------------------------*/
     /*  Sprite Clipping                                                  */
     /*-------------------------------------------------------------------*/
-    if (!(PPU_R1 & R1_CLIP_SP))
+    if (!(rLine.byR1 & R1_CLIP_SP))
     {
-      WORD *pPointTop;
+      Pixel *pPointTop;
 
-      // pPointTop = &WorkFrame[PPU_Scanline * NES_DISP_WIDTH];
-      pPointTop = WorkLine;
-      InfoNES_MemorySet(pPointTop, 0, 8 << 1);
+      // pPointTop = &WorkFrame[rLine.wLine * NES_DISP_WIDTH];
+      pPointTop = static_cast<Pixel *>(pBuf);
+      InfoNES_MemorySet(pPointTop, Format::BLACK, 8 * sizeof(Pixel));
     }
 
-    if (nSprCnt >= 8)
-      PPU_R2 |= R2_MAX_SP; // Set a flag of maximum sprites on scanline
-
     util::WorkMeterMark(MARKER_SPRITE);
   }
+
+  return nSprCnt;
 }
 
 /*===================================================================*/
 /*                                                                   */
-/* InfoNES_GetSprHitY() : Get a position of scanline hits sprite #0  */
+/*   InfoNES_LineHash() : Get a fingerprint of a scanline's inputs   */
 /*                                                                   */
 /*===================================================================*/
-void __not_in_flash_func(InfoNES_GetSprHitY)()
+DWORD __not_in_flash_func(InfoNES_LineHash)(int *pnSprCnt)
 {
   /*
- * Get a position of scanline hits sprite #0
+ *  Get a fingerprint of the inputs of a scanline
+ *
+ *  Parameters
+ *    int *pnSprCnt                     (Write)
+ *      The number of sprites on the scanline
  *
+ *  Return values
+ *    FNV-1a hash of the PPU registers, the bank pointers, the write
+ *    generations of the name table and attribute rows, the palette,
+ *    the pattern RAM and the sprites on the scanline. Never 0.
  */
 
-#if 0
-  int nYBit;
-  DWORD *pdwChrData;
-  int nOff;
-
-  if (SPRRAM[SPR_ATTR] & SPR_ATTR_V_FLIP)
-  {
-    // Vertical flip
-    nYBit = (PPU_SP_Height - 1) << 3;
-    nOff = -2;
-  }
-  else
+  auto mix = [](DWORD dwHash, DWORD dwData) __attribute__((always_inline))
   {
-    // Non flip
-    nYBit = 0;
-    nOff = 2;
-  }
+    return (dwHash ^ dwData) * 0x01000193;
+  };
 
-  if (PPU_R0 & R0_SP_SIZE)
-  {
-    // Sprite size 8x16
-    if (SPRRAM[SPR_CHR] & 1)
-    {
-      pdwChrData = (DWORD *)(ChrBuf + 256 * 64 + ((SPRRAM[SPR_CHR] & 0xfe) << 6) + nYBit);
-    }
-    else
-    {
-      pdwChrData = (DWORD *)(ChrBuf + ((SPRRAM[SPR_CHR] & 0xfe) << 6) + nYBit);
-    }
-  }
-  else
+  DWORD dwHash = 0x811c9dc5;
+
+  // Scroll and control registers
+  dwHash = mix(dwHash, PPU_Addr | (PPU_Scr_H_Bit << 16) | (PPU_UpDown_Clip << 24));
+  dwHash = mix(dwHash, PPU_R0 | (PPU_R1 << 8) | (PPU_SP_Height << 16));
+
+  // Palette and pattern RAM
+  dwHash = mix(dwHash, PPU_PalGen | (PPU_ChrGen << 16));
+
+  // Pattern table and name table banks
+  for (int nPage = 0; nPage < NAME_TABLE3 + 1; ++nPage)
   {
-    // Sprite size 8x8
-    pdwChrData = (DWORD *)(PPU_SP_Base + (SPRRAM[SPR_CHR] << 6) + nYBit);
+    dwHash = mix(dwHash, reinterpret_cast<uintptr_t>(PPUBANK[nPage]));
   }
 
-  if ((SPRRAM[SPR_Y] + 1 <= SCAN_UNKNOWN_START) && (SPRRAM[SPR_Y] > 0))
+  // Name table row and attribute row of the left and the right table
+  const int nY = (PPU_Addr >> 5) & 31;
+  const int nNameTable = NAME_TABLE0 + ((PPU_Addr >> 10) & 3);
+  auto rowGen = [nY](const BYTE *pbyPage) __attribute__((always_inline))
+  {
+    return PPU_VRAMROWGEN(pbyPage, nY << 5) |
+           (PPU_VRAMROWGEN(pbyPage, 0x3c0 + (nY >> 2) * 8) << 16);
+  };
+  dwHash = mix(dwHash, rowGen(PPUBANK[nNameTable]));
+  dwHash = mix(dwHash, rowGen(PPUBANK[nNameTable ^ NAME_TABLE_H_MASK]));
+
+  // Sprites on the scanline
+  int nSprCnt = 0;
+  if (PPU_R1 & R1_SHOW_SP)
   {
-    for (int nLine = 0; nLine < PPU_SP_Height; nLine++)
+    for (BYTE *pSPRRAM = SPRRAM + (63 << 2); pSPRRAM >= SPRRAM; pSPRRAM -= 4)
     {
-      if (pdwChrData[0] | pdwChrData[1])
-      {
-        // Scanline hits sprite #0
-        SpriteJustHit = SPRRAM[SPR_Y] + 1 + nLine;
-        nLine = SCAN_VBLANK_END;
-      }
-      pdwChrData += nOff;
+      int nSprY = pSPRRAM[SPR_Y] + 1;
+      if (nSprY > PPU_Scanline || nSprY + PPU_SP_Height <= PPU_Scanline)
+        continue; // Next sprite
+
+      ++nSprCnt;
+      dwHash = mix(dwHash, pSPRRAM[SPR_Y] | (pSPRRAM[SPR_CHR] << 8) |
+                               (pSPRRAM[SPR_ATTR] << 16) | (pSPRRAM[SPR_X] << 24));
     }
   }
-  else
-  {
-    // Scanline didn't hit sprite #0
-    SpriteJustHit = SCAN_UNKNOWN_START + 1;
-  }
-#else
-  const int patternTableIdSP88 = PPU_R0 & R0_SP_ADDR ? 1 : 0;
-  const int bankOfsSP88 = patternTableIdSP88 << 2;
 
-  int yOfsMod;
-  int stride;
+  *pnSprCnt = nSprCnt;
+  return dwHash | 1;
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*  InfoNES_GetSprHitX() : Get a position of the current scanline    */
+/*                         hits sprite #0                            */
+/*                                                                   */
+/*===================================================================*/
+int __not_in_flash_func(InfoNES_GetSprHitX)()
+{
+  /*
+ *  Get a position of the current scanline hits sprite #0
+ *
+ *  Return values
+ *    X of the first opaque pixel of sprite #0 over an opaque pixel of
+ *    the background, -1 if none
+ *
+ *  Remarks
+ *    The pixels are looked up the same way as InfoNES_DrawLine(), with
+ *    the PPU state at the start of the scanline.
+ */
+
+  // Row of sprite #0 on the scanline
+  int nRow = PPU_Scanline - 1 - SPRRAM[SPR_Y];
+  if (nRow < 0 || nRow >= PPU_SP_Height)
+    return -1;
+
   if (SPRRAM[SPR_ATTR] & SPR_ATTR_V_FLIP)
-  {
-    // Vertical flip
-    yOfsMod = PPU_SP_Height - 1;
-    stride = -1;
-  }
-  else
-  {
-    // Non flip
-    yOfsMod = 0;
-    stride = 1;
-  }
+    nRow = PPU_SP_Height - 1 - nRow;
 
   int ch = SPRRAM[SPR_CHR];
-
-  int bankOfs;
+  WORD wAddr;
   if (PPU_R0 & R0_SP_SIZE)
   {
     // 8x16
-    bankOfs = (ch & 1) << 2;
-    ch &= 0xfe;
+    wAddr = ((ch & 1) << 12) | ((ch & 0xfe) << 4) | ((nRow & 8) << 1) | (nRow & 7);
   }
   else
   {
     // 8x8
-    bankOfs = bankOfsSP88;
+    wAddr = ((PPU_R0 & R0_SP_ADDR) << 9) | (ch << 4) | nRow;
   }
 
-  const int bank = (ch >> 6) + bankOfs;
-  const int addrOfs = ((ch & 63) << 4) + ((yOfsMod & 8) << 1) + (yOfsMod & 7);
+  const auto spData = PPUBANK[wAddr >> 10] + (wAddr & 0x3ff);
+  const int nSpPat = spData[0] | spData[8];
+  if (!nSpPat)
+    return -1;
 
-  auto *data = PPUBANK[bank] + addrOfs;
+  // Bit 7 is the left end unless flipped
+  const bool bHFlip = SPRRAM[SPR_ATTR] & SPR_ATTR_H_FLIP;
 
-  if ((SPRRAM[SPR_Y] + 1 <= SCAN_UNKNOWN_START) && (SPRRAM[SPR_Y] > 0))
-  {
-    for (int nLine = 0; nLine < PPU_SP_Height; nLine++)
-    {
-      if (data[0] | data[8])
-      {
-        // Scanline hits sprite #0
-        SpriteJustHit = SPRRAM[SPR_Y] + 1 + nLine;
-        nLine = SCAN_VBLANK_END;
-      }
-      data += stride;
-    }
-  }
-  else
+  // The left end is clipped by either
+  const int nClipX = ((PPU_R1 & R1_CLIP_SP) && (PPU_R1 & R1_CLIP_BG)) ? 0 : 8;
+
+  // The background of the line as InfoNES_DrawLine() renders it
+  const int yOfsModBG = PPU_Addr >> 12;
+  const int nY = (PPU_Addr >> 5) & 31;
+  const int nBgX = ((PPU_Addr & 31) << 3) + PPU_Scr_H_Bit;
+  const int nBgNameTable = NAME_TABLE0 + ((PPU_Addr >> 10) & 3);
+  const int bgBase = (PPU_R0 & R0_BG_ADDR) << 8;
+
+  for (int nIdx = 0; nIdx < 8; ++nIdx)
   {
-    // Scanline didn't hit sprite #0
-    SpriteJustHit = SCAN_UNKNOWN_START + 1;
+    const int nX = SPRRAM[SPR_X] + nIdx;
+
+    // Never hits at the right end
+    if (nX >= NES_DISP_WIDTH - 1)
+      break;
+
+    if (!(nSpPat & (bHFlip ? 1 << nIdx : 0x80 >> nIdx)) || nX < nClipX)
+      continue;
+
+    // Pixel of the background
+    const int nCol = nBgX + nX;
+    const int nNameTable = nBgNameTable ^ ((nCol & 0x100) ? NAME_TABLE_H_MASK : 0);
+    const int bgCh = PPUBANK[nNameTable][nY * 32 + ((nCol >> 3) & 31)];
+    const WORD wBgAddr = bgBase | (bgCh << 4) | yOfsModBG;
+    const auto bgData = PPUBANK[wBgAddr >> 10] + (wBgAddr & 0x3ff);
+
+    if ((bgData[0] | bgData[8]) & (0x80 >> (nCol & 7)))
+      return nX;
   }
 
-#endif
+  // Scanline didn't hit sprite #0
+  return -1;
 }
 
 /*===================================================================*/
@@ -14,6 +14,7 @@
 /*-------------------------------------------------------------------*/
 
 #include "InfoNES_Types.h"
+#include "InfoNES_Pixel.h"
 
 /*-------------------------------------------------------------------*/
 /*  NES resources                                                    */
@@ -21,7 +22,12 @@
 
 #define RAM_SIZE 0x2000
 #define SRAM_SIZE 0x2000
-#define PPURAM_SIZE 0x4000
+/* Arena of the name tables and CHR-RAM ( 2KB + 32KB CHR-RAM at most,
+   a build for less SRAM defines a smaller one ) */
+#ifndef PPURAM_SIZE
+#define PPURAM_SIZE 0x8800
+#endif
+#define PALRAM_SIZE 0x20
 #define SPRRAM_SIZE 256
 
 /* RAM */
@@ -52,9 +58,27 @@ extern BYTE *ROMBANK[4];
 /*  PPU resources                                                    */
 /*-------------------------------------------------------------------*/
 
-/* PPU RAM */
+/* PPU RAM ( the arena, allocated by InfoNES_SetupPPURAM() ) */
 extern BYTE PPURAM[];
 
+/* Name table RAM ( 2KB, or 4KB for four screen ) */
+extern BYTE *PPU_NameRam;
+extern BYTE PPU_NameRamMask;
+
+/* Palettes of the tiles in PPU_NameRam ( a word per row of tiles,
+   2 bits per 2 tiles, kept by writes to the attribute tables ) */
+extern DWORD PPU_AttrRows[4][32];
+
+/* CHR-RAM ( the size in the header, or by the mapper ) */
+extern BYTE *PPU_ChrRam;
+extern BYTE PPU_ChrRamMask;
+
+/* Palette RAM */
+extern BYTE PPU_PalRam[];
+
+/* Entries of PalTable to pack again from PPU_PalRam ( bit mask ) */
+extern DWORD PPU_PalDirty;
+
 /* VROM */
 extern BYTE *VROM;
 
@@ -149,6 +173,10 @@ extern BYTE PPU_UpDown_Clip;
 // #define STEP_PER_FRAME 29828
 #define STEP_PER_SCANLINE 114 // 113.66
 #define STEP_PER_FRAME 29780 // 29780.5
+/* Dots of the PPU in a step of the CPU, the H-Blank is past dot 256 */
+#define DOTS_PER_STEP 3 // 341 / 113.66
+/* Dot where MMC3 sees the sprite fetches, the first one is at dot 257 */
+#define DOT_SPRITE_FETCH 260
 
 /* Develop Scroll Registers */
 #if 0
@@ -186,6 +214,60 @@ extern BYTE *PPU_SP_Base;
 /* Sprite Height */
 extern WORD PPU_SP_Height;
 
+/* Generation counters of PPU memory writes ( for dirty scanline detection ) */
+extern WORD PPU_VramRowGen[16][32];
+extern WORD PPU_ChrGen;
+extern WORD PPU_PalGen;
+
+/* Generation counter of a 32 bytes row in a 1Kb page of PPURAM */
+#define PPU_VRAMROWGEN(p, a) PPU_VramRowGen[(((p)-PPURAM) >> 10) & 15][((a) >> 5) & 31]
+
+/* Raster split : PPU state of a span of the current scanline */
+struct PPU_Split_tag
+{
+  WORD wEndX;        // The span ends before this dot
+  WORD wAddr;        // PPU_Addr
+  BYTE byScrHBit;    // PPU_Scr_H_Bit
+  BYTE byR0;         // PPU_R0
+  BYTE byR1;         // PPU_R1
+  BYTE *pbyBank[12]; // PPUBANK[ 0 - 11 ]
+};
+
+#define PPU_SPLIT_MAX 8
+
+extern struct PPU_Split_tag PPU_Split[];
+extern int PPU_SplitCnt;
+
+/* PPU state a scanline is rendered from */
+struct PPU_Line_tag
+{
+  WORD wLine;                                // PPU_Scanline
+  WORD wAddr;                                // PPU_Addr
+  BYTE byScrHBit;                            // PPU_Scr_H_Bit
+  BYTE byR0;                                 // PPU_R0
+  BYTE byR1;                                 // PPU_R1
+  BYTE bySplitCnt;                           // PPU_SplitCnt
+  BYTE *const *ppbyBank;                     // PPUBANK or pbyBank
+  const struct PPU_Split_tag *pSplit;        // PPU_Split or Split
+  BYTE *pbyBank[12];                         // A copy of PPUBANK[ 0 - 11 ]
+  struct PPU_Split_tag Split[PPU_SPLIT_MAX]; // A copy of PPU_Split
+};
+
+/* Line pipeline : Render scanlines on another core ( 0: Disabled, 1: Enabled ) */
+extern BYTE LinePipeline_Enable;
+
+/* Line pipeline : Whether it is used for the cassette */
+extern bool PPU_LinePipeline;
+
+/* CPU clocks at the start of the current scanline */
+extern WORD PPU_LineClocks;
+
+/* PPU engine ( 0: Scanline, 1: Dot ) */
+extern BYTE PPU_DotEngine;
+
+/* Selection of the PPU engine ( 0: Scanline, 1: Dot for the ROMs in the table, 2: Dot ) */
+extern BYTE DotEngine_Select;
+
 /* NES display size */
 #define NES_DISP_WIDTH 256
 #define NES_DISP_HEIGHT 240
@@ -193,10 +275,6 @@ extern WORD PPU_SP_Height;
 /* VRAM Write Enable ( 0: Disable, 1: Enable ) */
 extern BYTE byVramWriteEnable;
 
-/* Frame IRQ ( 0: Disabled, 1: Enabled )*/
-extern BYTE FrameIRQ_Enable;
-extern WORD FrameStep;
-
 /*-------------------------------------------------------------------*/
 /*  Display and Others resouces                                      */
 /*-------------------------------------------------------------------*/
@@ -206,19 +284,63 @@ extern WORD FrameSkip;
 extern WORD FrameCnt;
 extern WORD FrameWait;
 
-#if 0
-extern WORD DoubleFrame[ 2 ][ NES_DISP_WIDTH * NES_DISP_HEIGHT ];
-extern WORD *WorkFrame;
-extern WORD WorkFrameIdx;
-#else
-extern WORD WorkFrame[NES_DISP_WIDTH * NES_DISP_HEIGHT];
+/* Adaptive Frame Skip ( 0: Disabled, 1: Enabled ) */
+extern BYTE AutoFrameSkip;
+/* The number of frames skipped by the adaptive frame skip */
+extern DWORD SkippedFrames;
+
+/* Real time of a frame [us] */
+#define FRAME_TIME_US 16639 // 1 / 60.0988Hz
+/* Period of the display pacing the frames [us], FRAME_TIME_US by default */
+extern DWORD AutoSkipPeriod;
+/* Start skipping when the emulation is behind the display by [us] */
+#define AUTOSKIP_ON_US ((int)AutoSkipPeriod / 2)
+/* Stop skipping when the emulation has caught up to [us] */
+#define AUTOSKIP_OFF_US ((int)AutoSkipPeriod / 8)
+/* Maximum number of successive skipped frames */
+#define AUTOSKIP_MAX 3
+
+/* Dirty Scanline Detection ( 0: Disabled, 1: Enabled ) */
+extern BYTE DirtyLine_Enable;
+
+/* Full-frame render target ( 0: Not compiled, 1: Compiled ) */
+#ifndef INFONES_FULL_FRAME
+#define INFONES_FULL_FRAME 0
 #endif
 
+#if INFONES_FULL_FRAME
+/* Double buffer of whole frames in the pixel format */
+extern BYTE DoubleFrame[2][NES_DISP_WIDTH * NES_DISP_HEIGHT * PIXEL_MAX_SIZE];
+extern BYTE *WorkFrame;
+extern BYTE WorkFrameIdx;
+#endif
+
+/* Render into the full-frame target instead of the system's lines */
+extern bool FullFrame_Enable;
+
+/* Rendered scanlines ( PPU_DrawTop <= line < PPU_DrawBottom ) */
+extern BYTE PPU_DrawTop;
+extern BYTE PPU_DrawBottom;
+
 extern BYTE ChrBuf[];
 
 extern BYTE ChrBufUpdate;
 
-extern WORD PalTable[];
+/* Line buffer of the scanline being rendered */
+extern void *WorkLine;
+
+extern DWORD PalTable[];
+
+/* Pixel format of the line buffer */
+extern BYTE PPU_PixelFormat;
+extern BYTE PPU_PixelSize;
+
+/* NES colors packed in the pixel format ( a bank per color emphasis ) */
+extern DWORD PixelLUT[8][64];
+extern DWORD PixelBgClear;
+
+/* Greyscale and color emphasis bits of PPU_R1 the palette table is for */
+extern BYTE PPU_ColorMode;
 
 /*-------------------------------------------------------------------*/
 /*  APU and Pad resources                                            */
@@ -266,6 +388,11 @@ extern void (*MapperPPU)(WORD wAddr);
 /* Callback at Rendering Screen 1:BG, 0:Sprite */
 extern void (*MapperRenderScreen)(BYTE byMode);
 
+/* Hooks of the mapper called by the scanline renderer */
+#define MAPPER_HOOK_PPU 1    /* MapperPPU */
+#define MAPPER_HOOK_RENDER 2 /* MapperRenderScreen */
+extern BYTE PPU_MapperHooks;
+
 /*-------------------------------------------------------------------*/
 /*  ROM information                                                  */
 /*-------------------------------------------------------------------*/
@@ -293,6 +420,9 @@ extern BYTE ROM_SRAM;
 extern BYTE ROM_Trainer;
 extern BYTE ROM_FourScr;
 
+/* CRC32 of PRG and CHR ROM ( 0 unless the dot engine looks it up ) */
+extern DWORD ROM_Crc32;
+
 /*-------------------------------------------------------------------*/
 /*  Function prototypes                                              */
 /*-------------------------------------------------------------------*/
@@ -315,6 +445,12 @@ void InfoNES_SetupPPU();
 /* Set up a Mirroring of Name Table */
 void InfoNES_Mirroring(int nType);
 
+/* Keep PPU_AttrRows for a write to an attribute table */
+void InfoNES_WriteAttr(const BYTE *pbyPage, int nOfs, BYTE byData);
+
+/* Get the palettes of a row of tiles in a name table */
+DWORD InfoNES_GetAttrRow(const BYTE *pbyPage, int nY);
+
 /* The main loop of InfoNES */
 void InfoNES_Main();
 
@@ -324,15 +460,83 @@ void InfoNES_Cycle();
 /* A function in H-Sync */
 int InfoNES_HSync();
 
+/* Allocate name tables and CHR-RAM from PPURAM */
+int InfoNES_SetupPPURAM();
+
+/* Set the pixel format of the line buffer */
+bool InfoNES_SetPixelFormat(int nFormat);
+
+/* Set greyscale and color emphasis of the palette table */
+void InfoNES_SetColorMode(BYTE byR1);
+
+/* Pack the palette entries written since the last scanline */
+void InfoNES_UpdatePalette();
+
+/* Apply color emphasis to a NES color */
+WORD InfoNES_EmphasizeColor(WORD wRGB555, int nEmphasis);
+
+/* Pack a NES color in the pixel format and the color mode */
+inline DWORD InfoNES_PackColor(BYTE byColor)
+{
+  return PixelLUT[PPU_ColorMode >> 5][byColor & ((PPU_ColorMode & R1_MONOCHROME) ? 0x30 : 0x3f)];
+}
+
+/* Record a raster split before a write to the PPU */
+void InfoNES_SplitLine();
+
 /* Render a scanline */
 void InfoNES_DrawLine();
+template <class Format, int Hooks>
+int InfoNES_DrawLine(const struct PPU_Line_tag &rLine, void *pBuf);
+
+/* Line pipeline : Get the PPU state of the current scanline */
+void InfoNES_GetLineState(struct PPU_Line_tag *pLine, bool bCopy);
+
+/* Line pipeline : Render a scanline from its record */
+void InfoNES_RenderLine(const struct PPU_Line_tag *pLine, void *pBuf);
+
+/* Line pipeline : Wait for the queued scanlines before PPU memory changes */
+void InfoNES_FlushLines(); // InfoNES_System.h
+inline void InfoNES_SyncLines()
+{
+  if (PPU_LinePipeline)
+    InfoNES_FlushLines();
+}
+
+/* Get a fingerprint of the inputs of a scanline */
+DWORD InfoNES_LineHash(int *pnSprCnt);
 
-/* Get a position of scanline hits sprite #0 */
-void InfoNES_GetSprHitY();
+/* Dot engine : Whether a ROM is rendered with it */
+bool InfoNES_IsDotEngineRom(DWORD dwCrc);
+
+/* Dot engine : Reset, catch up with the CPU, finish and put a scanline */
+void InfoNES_DotReset();
+void InfoNES_DotCatchUp();
+void InfoNES_DotHSync();
+void InfoNES_DotDrawLine();
+
+/* Run the dot engine up to the CPU before an access to the PPU */
+inline void InfoNES_DotSync()
+{
+  if (PPU_DotEngine)
+    InfoNES_DotCatchUp();
+}
+
+/* Calculate CRC32 */
+DWORD InfoNES_Crc32(const BYTE *pbyData, DWORD dwSize, DWORD dwCrc);
+
+/* Get a position of the current scanline hits sprite #0 */
+int InfoNES_GetSprHitX();
 
 /* Develop character data */
 void InfoNES_SetupChr();
 
-void InfoNES_SetLineBuffer(WORD *p, WORD size);
+void InfoNES_SetLineBuffer(void *p, WORD size);
+
+/* Enable the full-frame render target */
+bool InfoNES_SetFullFrame(bool bEnable, bool bAllLines);
+
+/* Get the last frame rendered in the full-frame target */
+const void *InfoNES_GetFrame(int *pnPitch);
 
 #endif /* !InfoNES_H_INCLUDED */
@@ -14,6 +14,7 @@
 #include "InfoNES_System.h"
 #include "InfoNES_Mapper.h"
 #include "K6502.h"
+#include "InfoNES_pAPUExt.h"
 #include <pico.h>
 
 /*-------------------------------------------------------------------*/
@@ -34,7 +35,9 @@ struct MapperTable_tag MapperTable[] =
         {2, Map2_Init},
         {3, Map3_Init},
         {4, Map4_Init},
-        //        {5, Map5_Init},
+#if MAPPER_MMC5
+        {5, Map5_Init},
+#endif
         {6, Map6_Init},
         {7, Map7_Init},
         {8, Map8_Init},
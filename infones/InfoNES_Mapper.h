@@ -21,6 +21,11 @@
 
 #define DRAM_SIZE 0xA000
 
+/* MMC5 takes 67KB of static RAM for its WRAM and ExRAM */
+#ifndef MAPPER_MMC5
+#define MAPPER_MMC5 0
+#endif
+
 /*-------------------------------------------------------------------*/
 /*  Mapper resources                                                 */
 /*-------------------------------------------------------------------*/
@@ -39,9 +44,9 @@ extern BYTE DRAM[];
 /* The address of 1Kbytes unit of the VROM */
 #define VROMPAGE(a) &VROM[(a)*0x400]
 /* The address of 1Kbytes unit of the CRAM */
-#define CRAMPAGE(a) &PPURAM[0x0000 + ((a)&0x1F) * 0x400]
+#define CRAMPAGE(a) &PPU_ChrRam[((a)&PPU_ChrRamMask) * 0x400]
 /* The address of 1Kbytes unit of the VRAM */
-#define VRAMPAGE(a) &PPURAM[0x2000 + (a)*0x400]
+#define VRAMPAGE(a) &PPU_NameRam[((a)&PPU_NameRamMask) * 0x400]
 /* Translate the pointer to ChrBuf into the address of Pattern Table */
 #define PATTBL(a) (((a)-ChrBuf) >> 2)
 
@@ -84,6 +89,8 @@ void Map3_Write(WORD wAddr, BYTE byData);
 void Map4_Init();
 void Map4_Write(WORD wAddr, BYTE byData);
 void Map4_HSync();
+void Map4_PPU(WORD wAddr);
+void Map4_Clock();
 void Map4_Set_CPU_Banks();
 void Map4_Set_PPU_Banks();
 
@@ -0,0 +1,520 @@
+/*===================================================================*/
+/*                                                                   */
+/*  InfoNES_PPUDot.cpp : Dot-accurate PPU engine                     */
+/*                                                                   */
+/*  The PPU is run dot by dot with the background fetch pipeline     */
+/*  and shift registers of the real hardware. The CPU calls          */
+/*  InfoNES_DotSync() before it accesses the PPU, so the PPU catches */
+/*  up with the CPU only when the result can be seen.                */
+/*                                                                   */
+/*===================================================================*/
+
+/*-------------------------------------------------------------------*/
+/*  Include files                                                    */
+/*-------------------------------------------------------------------*/
+
+#include "InfoNES.h"
+#include "InfoNES_System.h"
+#include "InfoNES_Mapper.h"
+#include "K6502.h"
+#include <pico.h>
+
+/*-------------------------------------------------------------------*/
+/*  ROMs rendered with the dot engine                                */
+/*-------------------------------------------------------------------*/
+
+/* CRC32 of PRG and CHR ROM ( 0: Terminator ), the build adds DOT_ENGINE_ROMS */
+static const DWORD DotEngineRomTable[] =
+    {
+        // 0x12345678, // Title
+#ifdef DOT_ENGINE_ROMS
+        DOT_ENGINE_ROMS,
+#endif
+        0,
+};
+
+/*-------------------------------------------------------------------*/
+/*  Dot engine resources                                             */
+/*-------------------------------------------------------------------*/
+
+#define DOT_PER_SCANLINE 341
+
+/* PPU engine ( 0: Scanline, 1: Dot ) */
+BYTE PPU_DotEngine;
+
+/* Selection of the PPU engine ( 0: Scanline, 1: Dot for the ROMs in the table, 2: Dot ) */
+BYTE DotEngine_Select = 1;
+
+/* Dot of the PPU in the current scanline */
+WORD PPU_Dot;
+
+/* Latches of the background fetch */
+BYTE PPU_DotNT;
+BYTE PPU_DotAT;
+BYTE PPU_DotPatLo;
+BYTE PPU_DotPatHi;
+
+/* Shift registers of the background */
+WORD PPU_DotBgLo;
+WORD PPU_DotBgHi;
+WORD PPU_DotAtLo;
+WORD PPU_DotAtHi;
+
+/* Sprites of the scanline ( Bit0-3: Color, Bit5: Behind BG, Bit6: Sprite #0 ) */
+BYTE PPU_DotSpr[NES_DISP_WIDTH];
+bool PPU_DotSprOnLine;
+
+#define DOT_SPR_PRI 0x20
+#define DOT_SPR_ZERO 0x40
+
+/* Palette indexes of the scanline */
+BYTE PPU_DotLine[NES_DISP_WIDTH];
+
+/*===================================================================*/
+/*                                                                   */
+/*       InfoNES_IsDotEngineRom() : Whether a ROM is rendered        */
+/*                                  with the dot engine              */
+/*                                                                   */
+/*===================================================================*/
+bool InfoNES_IsDotEngineRom(DWORD dwCrc)
+{
+  for (int nIdx = 0; DotEngineRomTable[nIdx]; ++nIdx)
+  {
+    if (DotEngineRomTable[nIdx] == dwCrc)
+      return true;
+  }
+  return false;
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*            InfoNES_DotReset() : Reset the dot engine              */
+/*                                                                   */
+/*===================================================================*/
+void InfoNES_DotReset()
+{
+  /*
+ *  Reset the dot engine and select the PPU engine for the ROM
+ *
+ *  Remarks
+ *    The CRC32 of the whole ROM takes a while in flash, so it is
+ *    taken only when there are ROMs in the table to look up.
+ */
+
+  ROM_Crc32 = 0;
+  if (DotEngine_Select == 1 && DotEngineRomTable[0])
+  {
+    ROM_Crc32 = InfoNES_Crc32(ROM, NesHeader.byRomSize * 0x4000, 0);
+    ROM_Crc32 = InfoNES_Crc32(VROM, NesHeader.byVRomSize * 0x2000, ROM_Crc32);
+  }
+
+  PPU_DotEngine = DotEngine_Select == 2 ||
+                  (DotEngine_Select == 1 && InfoNES_IsDotEngineRom(ROM_Crc32));
+
+  PPU_Dot = 0;
+  PPU_DotNT = PPU_DotAT = PPU_DotPatLo = PPU_DotPatHi = 0;
+  PPU_DotBgLo = PPU_DotBgHi = PPU_DotAtLo = PPU_DotAtHi = 0;
+  InfoNES_MemorySet(PPU_DotSpr, 0, sizeof PPU_DotSpr);
+  PPU_DotSprOnLine = false;
+  InfoNES_MemorySet(PPU_DotLine, 0, sizeof PPU_DotLine);
+}
+
+/*-------------------------------------------------------------------*/
+/*  Operations of the PPU address ( Loopy's v and t )                */
+/*-------------------------------------------------------------------*/
+
+static inline BYTE InfoNES_DotRead(WORD wAddr)
+{
+  return PPUBANK[(wAddr >> 10) & 15][wAddr & 0x3ff];
+}
+
+static inline void InfoNES_DotIncX()
+{
+  if ((PPU_Addr & 0x001f) == 31)
+    PPU_Addr = (PPU_Addr & ~0x001f) ^ 0x0400;
+  else
+    ++PPU_Addr;
+}
+
+static inline void InfoNES_DotIncY()
+{
+  if ((PPU_Addr & 0x7000) != 0x7000)
+  {
+    PPU_Addr += 0x1000;
+    return;
+  }
+
+  PPU_Addr &= ~0x7000;
+  int nY = (PPU_Addr >> 5) & 31;
+  if (nY == 29)
+  {
+    nY = 0;
+    PPU_Addr ^= 0x0800;
+  }
+  else if (nY == 31)
+  {
+    nY = 0;
+  }
+  else
+  {
+    ++nY;
+  }
+  PPU_Addr = (PPU_Addr & ~0x03e0) | (nY << 5);
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*        InfoNES_DotFetch() : A dot of the background fetch         */
+/*                                                                   */
+/*===================================================================*/
+static inline void __not_in_flash_func(InfoNES_DotFetch)(int nDot)
+{
+  /*
+ *  A dot of the background fetch
+ *
+ *  Remarks
+ *    Dots 1 - 257 and 321 - 337 fetch, and all of them but 1 and 321
+ *    shift the registers. Every 8 dots fetch a name, an attribute and
+ *    two pattern bytes, and the registers are reloaded at the start
+ *    of the next 8 dots.
+ */
+
+  if (nDot != 1 && nDot != 321)
+  {
+    PPU_DotBgLo <<= 1;
+    PPU_DotBgHi <<= 1;
+    PPU_DotAtLo <<= 1;
+    PPU_DotAtHi <<= 1;
+  }
+
+  switch ((nDot - 1) & 7)
+  {
+  case 0:
+    // Reload the shift registers
+    PPU_DotBgLo = (PPU_DotBgLo & 0xff00) | PPU_DotPatLo;
+    PPU_DotBgHi = (PPU_DotBgHi & 0xff00) | PPU_DotPatHi;
+    PPU_DotAtLo = (PPU_DotAtLo & 0xff00) | ((PPU_DotAT & 1) ? 0xff : 0);
+    PPU_DotAtHi = (PPU_DotAtHi & 0xff00) | ((PPU_DotAT & 2) ? 0xff : 0);
+
+    // Name Table
+    PPU_DotNT = InfoNES_DotRead(0x2000 | (PPU_Addr & 0x0fff));
+    break;
+
+  case 2:
+    // Attribute Table
+    PPU_DotAT = InfoNES_DotRead(0x23c0 | (PPU_Addr & 0x0c00) |
+                                ((PPU_Addr >> 4) & 0x38) | ((PPU_Addr >> 2) & 0x07)) >>
+                (((PPU_Addr >> 4) & 4) | (PPU_Addr & 2));
+    break;
+
+  case 4:
+    // Pattern Table ( low )
+    PPU_DotPatLo = InfoNES_DotRead(((PPU_R0 & R0_BG_ADDR) << 8) | (PPU_DotNT << 4) | ((PPU_Addr >> 12) & 7));
+    break;
+
+  case 6:
+  {
+    // Pattern Table ( high )
+    WORD wAddr = ((PPU_R0 & R0_BG_ADDR) << 8) | (PPU_DotNT << 4) | ((PPU_Addr >> 12) & 7);
+    PPU_DotPatHi = InfoNES_DotRead(wAddr + 8);
+
+    // Callback at PPU read/write
+    MapperPPU(wAddr);
+  }
+  break;
+
+  case 7:
+    InfoNES_DotIncX();
+    break;
+  }
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*     InfoNES_DotSprites() : Evaluate and fetch the sprites of      */
+/*                            the next scanline                      */
+/*                                                                   */
+/*===================================================================*/
+static void __not_in_flash_func(InfoNES_DotSprites)(int nLine)
+{
+  /*
+ *  Evaluate and fetch the sprites of the next scanline
+ *
+ *  Parameters
+ *    int nLine                 (Read)
+ *      The scanline to display the sprites
+ *
+ *  Remarks
+ *    Done at once at dot 257, where the hardware starts fetching.
+ *    The eight fetches are made even for empty slots, so mappers
+ *    watching the pattern address see them.
+ */
+
+  InfoNES_MemorySet(PPU_DotSpr, 0, sizeof PPU_DotSpr);
+  PPU_DotSprOnLine = false;
+
+  int nSprCnt = 0;
+  if (nLine < NES_DISP_HEIGHT)
+  {
+    for (int nSpr = 0; nSpr < 64; ++nSpr)
+    {
+      BYTE *pSPRRAM = &SPRRAM[nSpr << 2];
+      int nRow = nLine - 1 - pSPRRAM[SPR_Y];
+      if (nRow < 0 || nRow >= PPU_SP_Height)
+        continue;
+
+      // Sprite overflow
+      if (nSprCnt == 8)
+      {
+        PPU_R2 |= R2_MAX_SP;
+        break;
+      }
+      ++nSprCnt;
+
+      BYTE byAttr = pSPRRAM[SPR_ATTR];
+      BYTE byChr = pSPRRAM[SPR_CHR];
+      if (byAttr & SPR_ATTR_V_FLIP)
+        nRow = PPU_SP_Height - 1 - nRow;
+
+      WORD wAddr;
+      if (PPU_SP_Height == 16)
+        wAddr = ((byChr & 1) << 12) | ((byChr & 0xfe) << 4) | ((nRow & 8) << 1) | (nRow & 7);
+      else
+        wAddr = ((PPU_R0 & R0_SP_ADDR) << 9) | (byChr << 4) | nRow;
+
+      BYTE byLo = InfoNES_DotRead(wAddr);
+      BYTE byHi = InfoNES_DotRead(wAddr + 8);
+
+      // Callback at PPU read/write
+      MapperPPU(wAddr);
+
+      BYTE bySprCol = ((byAttr & SPR_ATTR_COLOR) << 2) |
+                      ((byAttr & SPR_ATTR_PRI) ? DOT_SPR_PRI : 0) |
+                      (nSpr == 0 ? DOT_SPR_ZERO : 0);
+      int nShift = (byAttr & SPR_ATTR_H_FLIP) ? 0 : 7;
+      int nStep = (byAttr & SPR_ATTR_H_FLIP) ? 1 : -1;
+      for (int nX = pSPRRAM[SPR_X], nEnd = nX + 8; nX < nEnd && nX < NES_DISP_WIDTH; ++nX, nShift += nStep)
+      {
+        int nCol = ((byLo >> nShift) & 1) | (((byHi >> nShift) & 1) << 1);
+
+        // The sprite of the lower number has priority
+        if (nCol && !(PPU_DotSpr[nX] & 3))
+          PPU_DotSpr[nX] = bySprCol | nCol;
+      }
+      PPU_DotSprOnLine = true;
+    }
+  }
+
+  // Fetches of the empty slots
+  for (; nSprCnt < 8; ++nSprCnt)
+    MapperPPU(PPU_SP_Height == 16 ? 0x1ff0 : (((PPU_R0 & R0_SP_ADDR) << 9) | 0x0ff0));
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*        InfoNES_DotPixel() : Compose a pixel of the scanline       */
+/*                                                                   */
+/*===================================================================*/
+static inline void __not_in_flash_func(InfoNES_DotPixel)(int nX)
+{
+  int nBgCol = 0;
+  BYTE byIdx = 0;
+
+  if ((PPU_R1 & R1_SHOW_SCR) && (nX >= 8 || (PPU_R1 & R1_CLIP_BG)))
+  {
+    WORD wMask = 0x8000 >> PPU_Scr_H_Bit;
+    nBgCol = ((PPU_DotBgLo & wMask) ? 1 : 0) | ((PPU_DotBgHi & wMask) ? 2 : 0);
+    if (nBgCol)
+      byIdx = (((PPU_DotAtLo & wMask) ? 4 : 0) | ((PPU_DotAtHi & wMask) ? 8 : 0)) | nBgCol;
+  }
+
+  if (PPU_DotSprOnLine && (PPU_R1 & R1_SHOW_SP) && (nX >= 8 || (PPU_R1 & R1_CLIP_SP)))
+  {
+    BYTE bySpr = PPU_DotSpr[nX];
+    if (bySpr & 3)
+    {
+      // Sprite #0 hit on an opaque background pixel
+      if (nBgCol && (bySpr & DOT_SPR_ZERO) && nX != 255)
+        PPU_R2 |= R2_HIT_SP;
+
+      if (!nBgCol || !(bySpr & DOT_SPR_PRI))
+        byIdx = 0x10 | (bySpr & 0xf);
+    }
+  }
+
+  PPU_DotLine[nX] = byIdx;
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*           InfoNES_DotRun() : Run the PPU up to a dot              */
+/*                                                                   */
+/*===================================================================*/
+static void __not_in_flash_func(InfoNES_DotRun)(int nTarget)
+{
+  /*
+ *  Run the PPU up to a dot of the current scanline
+ *
+ *  Parameters
+ *    int nTarget               (Read)
+ *      The dot to stop at ( not run )
+ *
+ *  Remarks
+ *    The dots are run in segments of the same work, so the lines of
+ *    V-Blank and the lines with rendering off are skipped at once.
+ */
+
+  int nDot = PPU_Dot;
+  if (nDot >= nTarget)
+    return;
+  PPU_Dot = nTarget;
+
+  const bool bVisible = PPU_Scanline < NES_DISP_HEIGHT;
+  const bool bPreRender = PPU_Scanline == SCAN_VBLANK_END;
+
+  // Idle in V-Blank
+  if (!bVisible && !bPreRender)
+    return;
+
+  // Clear the flags at the start of the pre-render line
+  if (bPreRender && nDot <= 1 && nTarget > 1)
+    PPU_R2 &= ~(R2_IN_VBLANK | R2_HIT_SP | R2_MAX_SP);
+
+  // Rendering off : the backdrop only
+  if (!(PPU_R1 & (R1_SHOW_SCR | R1_SHOW_SP)))
+  {
+    if (bVisible && nDot < NES_DISP_WIDTH + 1)
+    {
+      int nStart = nDot < 1 ? 0 : nDot - 1;
+      int nEnd = nTarget < NES_DISP_WIDTH + 1 ? nTarget - 1 : NES_DISP_WIDTH;
+      if (nEnd > nStart)
+        InfoNES_MemorySet(&PPU_DotLine[nStart], 0, nEnd - nStart);
+    }
+    return;
+  }
+
+  // Dot 0 is idle
+  if (nDot == 0)
+    nDot = 1;
+
+  // Dots 1 - 256 : Fetch and draw
+  for (int nEnd = nTarget < 257 ? nTarget : 257; nDot < nEnd; ++nDot)
+  {
+    InfoNES_DotFetch(nDot);
+
+    if (bVisible)
+      InfoNES_DotPixel(nDot - 1);
+
+    if (nDot == 256)
+      InfoNES_DotIncY();
+  }
+
+  if (nDot >= nTarget)
+    return;
+
+  // Dot 257 : Shift, reload, horizontal copy and the sprites of the next line
+  if (nDot == 257)
+  {
+    InfoNES_DotFetch(nDot);
+    PPU_Addr = (PPU_Addr & ~0x041f) | (PPU_Temp & 0x041f);
+    InfoNES_DotSprites(bVisible ? PPU_Scanline + 1 : NES_DISP_HEIGHT);
+    ++nDot;
+  }
+
+  // Dots 280 - 304 of the pre-render line : Vertical copy
+  if (bPreRender && nDot <= 304 && nTarget > 280)
+    PPU_Addr = (PPU_Addr & ~0x7be0) | (PPU_Temp & 0x7be0);
+
+  // Dots 321 - 337 : The first two tiles of the next line
+  if (nDot < 321)
+    nDot = 321;
+  for (int nEnd = nTarget < 338 ? nTarget : 338; nDot < nEnd; ++nDot)
+  {
+    InfoNES_DotFetch(nDot);
+  }
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*    InfoNES_DotCatchUp() : Run the PPU up to the dot of the CPU    */
+/*                                                                   */
+/*===================================================================*/
+void __not_in_flash_func(InfoNES_DotCatchUp)()
+{
+  /*
+ *  Run the PPU up to the dot of the CPU
+ *
+ *  Remarks
+ *    A CPU clock is three dots. Called through InfoNES_DotSync()
+ *    before the CPU accesses the PPU.
+ */
+
+  int nDot = (WORD)(getCurrentClocks() - PPU_LineClocks) * 3;
+  InfoNES_DotRun(nDot < DOT_PER_SCANLINE ? nDot : DOT_PER_SCANLINE);
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*          InfoNES_DotHSync() : Finish the current scanline         */
+/*                                                                   */
+/*===================================================================*/
+void __not_in_flash_func(InfoNES_DotHSync)()
+{
+  /*
+ *  Finish the current scanline
+ *
+ *  Remarks
+ *    The palette indexes of the scanline are kept in PPU_DotLine
+ *    until InfoNES_DotDrawLine() puts them in the line buffer.
+ */
+
+  InfoNES_DotRun(DOT_PER_SCANLINE);
+  PPU_Dot = 0;
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*    InfoNES_DotDrawLine() : Put a scanline in the line buffer      */
+/*                                                                   */
+/*===================================================================*/
+template <class Format>
+static void __not_in_flash_func(InfoNES_DotDrawLine)()
+{
+  typedef typename Format::Pixel Pixel;
+
+  Pixel *pPoint = static_cast<Pixel *>(WorkLine);
+  for (int nX = 0; nX < NES_DISP_WIDTH; ++nX)
+    pPoint[nX] = static_cast<Pixel>(PalTable[PPU_DotLine[nX]]);
+}
+
+void __not_in_flash_func(InfoNES_DotDrawLine)()
+{
+  /*
+ *  Put a scanline rendered by the dot engine in the line buffer
+ *
+ */
+
+  switch (PPU_PixelFormat)
+  {
+#if PIXEL_FORMATS & (1 << PIXEL_RGB444)
+  case PIXEL_RGB444:
+    InfoNES_DotDrawLine<PixelRGB444>();
+    break;
+#endif
+#if PIXEL_FORMATS & (1 << PIXEL_RGB565)
+  case PIXEL_RGB565:
+    InfoNES_DotDrawLine<PixelRGB565>();
+    break;
+#endif
+#if PIXEL_FORMATS & (1 << PIXEL_XRGB8888)
+  case PIXEL_XRGB8888:
+    InfoNES_DotDrawLine<PixelXRGB8888>();
+    break;
+#endif
+#if PIXEL_FORMATS & (1 << PIXEL_INDEX8)
+  case PIXEL_INDEX8:
+    InfoNES_DotDrawLine<PixelIndex8>();
+    break;
+#endif
+  }
+}
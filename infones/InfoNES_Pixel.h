@@ -0,0 +1,111 @@
+/*===================================================================*/
+/*                                                                   */
+/*  InfoNES_Pixel.h : Pixel formats of the scanline renderer         */
+/*                                                                   */
+/*===================================================================*/
+
+#ifndef InfoNES_PIXEL_H_INCLUDED
+#define InfoNES_PIXEL_H_INCLUDED
+
+/*-------------------------------------------------------------------*/
+/*  Include files                                                    */
+/*-------------------------------------------------------------------*/
+
+#include "InfoNES_Types.h"
+
+/*-------------------------------------------------------------------*/
+/*  Pixel format IDs                                                 */
+/*-------------------------------------------------------------------*/
+
+#define PIXEL_RGB444 0
+#define PIXEL_RGB565 1
+#define PIXEL_XRGB8888 2
+#define PIXEL_INDEX8 3
+
+/* Pixel formats compiled into the renderer ( bit mask of the IDs ) */
+#ifndef PIXEL_FORMATS
+#define PIXEL_FORMATS (1 << PIXEL_RGB444)
+#endif
+
+/* Format at the start, the first one compiled */
+#define PIXEL_DEFAULT                                        \
+  ((PIXEL_FORMATS & (1 << PIXEL_RGB444))     ? PIXEL_RGB444   \
+   : (PIXEL_FORMATS & (1 << PIXEL_RGB565))   ? PIXEL_RGB565   \
+   : (PIXEL_FORMATS & (1 << PIXEL_XRGB8888)) ? PIXEL_XRGB8888 \
+                                             : PIXEL_INDEX8)
+
+/* Bytes of the largest pixel in the compiled formats */
+#define PIXEL_MAX_SIZE                                                 \
+  ((PIXEL_FORMATS & (1 << PIXEL_XRGB8888))                           ? 4 \
+   : (PIXEL_FORMATS & ((1 << PIXEL_RGB444) | (1 << PIXEL_RGB565))) ? 2 \
+                                                                    : 1)
+
+/*-------------------------------------------------------------------*/
+/*  Pixel formats                                                    */
+/*                                                                   */
+/*  Pixel     : Type of a pixel in the line buffer                   */
+/*  BG_CLEAR  : Flag of a transparent background pixel, which lets   */
+/*              the sprites behind the background show through       */
+/*  BLACK     : Pixel of a cleared line ( a byte repeated )          */
+/*  pack()    : Pack a NES color ( 0x00 - 0x3f ) given as RGB555     */
+/*-------------------------------------------------------------------*/
+
+/* 0x0RGB, for the DVI output */
+struct PixelRGB444
+{
+  typedef WORD Pixel;
+  static constexpr int ID = PIXEL_RGB444;
+  static constexpr DWORD BG_CLEAR = 0x8000;
+  static constexpr BYTE BLACK = 0;
+
+  static constexpr DWORD pack(BYTE, WORD wRGB555)
+  {
+    return ((wRGB555 >> 1) & 15) | (((wRGB555 >> 6) & 15) << 4) | (((wRGB555 >> 11) & 15) << 8);
+  }
+};
+
+/* RRRRRGGGGGGBBBBB, the LSB of green is used as BG_CLEAR */
+struct PixelRGB565
+{
+  typedef WORD Pixel;
+  static constexpr int ID = PIXEL_RGB565;
+  static constexpr DWORD BG_CLEAR = 0x0020;
+  static constexpr BYTE BLACK = 0;
+
+  static constexpr DWORD pack(BYTE, WORD wRGB555)
+  {
+    return ((wRGB555 & 0x7fe0) << 1) | (wRGB555 & 0x001f);
+  }
+};
+
+/* 0xXXRRGGBB, X is used as BG_CLEAR */
+struct PixelXRGB8888
+{
+  typedef DWORD Pixel;
+  static constexpr int ID = PIXEL_XRGB8888;
+  static constexpr DWORD BG_CLEAR = 0x01000000;
+  static constexpr BYTE BLACK = 0;
+
+  static constexpr DWORD expand(int n5) { return (n5 << 3) | (n5 >> 2); }
+  static constexpr DWORD pack(BYTE, WORD wRGB555)
+  {
+    return (expand((wRGB555 >> 10) & 31) << 16) | (expand((wRGB555 >> 5) & 31) << 8) |
+           expand(wRGB555 & 31);
+  }
+};
+
+/* NES color index, converted to RGB by the system later */
+struct PixelIndex8
+{
+  typedef BYTE Pixel;
+  static constexpr int ID = PIXEL_INDEX8;
+  static constexpr DWORD BG_CLEAR = 0x80;
+  static constexpr BYTE BLACK = 0x0f;
+
+  static constexpr DWORD pack(BYTE byColor, WORD)
+  {
+    return byColor;
+  }
+};
+
+#endif /* !InfoNES_PIXEL_H_INCLUDED */
@@ -59,6 +59,9 @@ void InfoNES_DebugPrint(const char *pszMsg);
 /* Wait */
 inline void InfoNES_Wait() {}
 
+/* Get a free running counter in microseconds */
+DWORD InfoNES_GetMicroSec();
+
 /* Sound Initialize */
 void InfoNES_SoundInit(void);
 
@@ -72,10 +75,31 @@ void InfoNES_SoundClose(void);
 void InfoNES_SoundOutput(int samples, BYTE *wave1, BYTE *wave2, BYTE *wave3, BYTE *wave4, BYTE *wave5);
 int InfoNES_GetSoundBufferSize();
 
+/* Get the samples the sound buffer holds, 0 disables the rate control */
+int InfoNES_GetSoundBufferCapacity();
+
+/* Get the space for up to `samples` stereo samples ( L, R interleaved ), returns the count */
+int InfoNES_SoundLockSamples(short **ppSamples, int samples);
+
+/* Pass the stereo samples written to the locked space */
+void InfoNES_SoundUnlockSamples(int samples);
+
 /* Print system message */
 void InfoNES_MessageBox(const char *pszMsg, ...);
 
 void InfoNES_PreDrawLine(int line);
 void InfoNES_PostDrawLine(int line);
 
+/* Reuse the last frame's pixels of a scanline, false if not available */
+bool InfoNES_ReuseLine(int line);
+
+/* Line pipeline : Get a free record for a scanline ( waits for one ) */
+struct PPU_Line_tag *InfoNES_GetLineRecord(int line);
+
+/* Line pipeline : Pass a filled record to InfoNES_RenderLine() on the other core */
+void InfoNES_QueueLine(struct PPU_Line_tag *pLine);
+
+/* Line pipeline : Wait until the queued scanlines are rendered */
+void InfoNES_FlushLines();
+
 #endif /* !InfoNES_SYSTEM_H_INCLUDED */
@@ -14,57 +14,121 @@
 #include "InfoNES_System.h"
 #include "InfoNES_pAPU.h"
 #include <algorithm>
+#include <limits.h>
+#include <math.h>
 #include <string.h>
 
 /*-------------------------------------------------------------------*/
 /*   APU Event resources                                             */
 /*-------------------------------------------------------------------*/
 
-struct ApuEvent_t ApuEventQueue[APU_EVENT_MAX];
-int cur_event;
+struct ApuEventQueue_t ApuEventQueue[APU_QUEUE_MAX];
+DWORD ApuEventOverflows;
 WORD entertime;
 
+/*-------------------------------------------------------------------*/
+/*  Queue a register write to a channel                              */
+/*  ( a write to a full queue is dropped and counted )               */
+/*-------------------------------------------------------------------*/
+static inline void ApuQueueEvent(int ch, short time, BYTE type, BYTE data)
+{
+  struct ApuEventQueue_t &q = ApuEventQueue[ch];
+  if (q.count >= APU_EVENT_MAX)
+  {
+    ++ApuEventOverflows;
+    return;
+  }
+  q.event[q.count].time = time;
+  q.event[q.count].type = type;
+  q.event[q.count].data = data;
+  q.count++;
+}
+
 /*-------------------------------------------------------------------*/
 /*   APU Register Write Functions                                    */
 /*-------------------------------------------------------------------*/
 
-#define APU_WRITEFUNC(name, evtype)                                \
-  void ApuWrite##name(WORD addr, BYTE value)                       \
-  {                                                                \
-    ApuEventQueue[cur_event].time = getPassedClocks() - entertime; \
-    ApuEventQueue[cur_event].type = APUET_W_##evtype;              \
-    ApuEventQueue[cur_event].data = value;                         \
-    cur_event++;                                                   \
+#define APU_WRITEFUNC(name, evtype, ch)                                          \
+  void ApuWrite##name(WORD addr, BYTE value)                                     \
+  {                                                                              \
+    ApuQueueEvent(ch, getCurrentClocks() - entertime, APUET_W_##evtype, value);  \
   }
 
-// 普通にバグってる
+APU_WRITEFUNC(C1a, C1A, 0);
+APU_WRITEFUNC(C1b, C1B, 0);
+APU_WRITEFUNC(C1c, C1C, 0);
+APU_WRITEFUNC(C1d, C1D, 0);
+
+APU_WRITEFUNC(C2a, C2A, 1);
+APU_WRITEFUNC(C2b, C2B, 1);
+APU_WRITEFUNC(C2c, C2C, 1);
+APU_WRITEFUNC(C2d, C2D, 1);
+
+APU_WRITEFUNC(C3a, C3A, 2);
+APU_WRITEFUNC(C3b, C3B, 2);
+APU_WRITEFUNC(C3c, C3C, 2);
+APU_WRITEFUNC(C3d, C3D, 2);
+
+APU_WRITEFUNC(C4a, C4A, 3);
+APU_WRITEFUNC(C4b, C4B, 3);
+APU_WRITEFUNC(C4c, C4C, 3);
+APU_WRITEFUNC(C4d, C4D, 3);
+
+APU_WRITEFUNC(C5a, C5A, 4);
+APU_WRITEFUNC(C5b, C5B, 4);
+APU_WRITEFUNC(C5c, C5C, 4);
+APU_WRITEFUNC(C5d, C5D, 4);
+
+/* The control register is fanned out to the queues of all the channels */
+void ApuWriteControl(WORD addr, BYTE value)
+{
+  short time = getCurrentClocks() - entertime;
+  for (int ch = 0; ch < APU_CHANNEL_MAX; ++ch)
+    ApuQueueEvent(ch, time, APUET_W_CTRL, value);
+}
 
-APU_WRITEFUNC(C1a, C1A);
-APU_WRITEFUNC(C1b, C1B);
-APU_WRITEFUNC(C1c, C1C);
-APU_WRITEFUNC(C1d, C1D);
+/* The frame counter is queued for the frame sequencer */
+void ApuWriteFrameCounter(WORD addr, BYTE value)
+{
+  // The interrupt inhibit clears the flag at once
+  if (value & 0x40)
+    ApuFrameIrq = 0;
 
-APU_WRITEFUNC(C2a, C2A);
-APU_WRITEFUNC(C2b, C2B);
-APU_WRITEFUNC(C2c, C2C);
-APU_WRITEFUNC(C2d, C2D);
+  ApuQueueEvent(APU_QUEUE_FRAME, getCurrentClocks() - entertime, APUET_W_FRAME, value);
+}
 
-APU_WRITEFUNC(C3a, C3A);
-APU_WRITEFUNC(C3b, C3B);
-APU_WRITEFUNC(C3c, C3C);
-APU_WRITEFUNC(C3d, C3D);
+/*-------------------------------------------------------------------*/
+/*  Expansion sound resources                                        */
+/*-------------------------------------------------------------------*/
+
+const struct ApuExtSound_t *ApuExt;
+DWORD ApuExtCycles16;
 
-APU_WRITEFUNC(C4a, C4A);
-APU_WRITEFUNC(C4b, C4B);
-APU_WRITEFUNC(C4c, C4C);
-APU_WRITEFUNC(C4d, C4D);
+/* Samples rendered at once to keep the cost in APU_EXT_BUDGET */
+static int ApuExtDivider = 1;
+static int ApuExtPhase;
 
-APU_WRITEFUNC(C5a, C5A);
-APU_WRITEFUNC(C5b, C5B);
-APU_WRITEFUNC(C5c, C5C);
-APU_WRITEFUNC(C5d, C5D);
+void InfoNES_pAPUSetExtSound(const struct ApuExtSound_t *pSound)
+{
+#if !APU_EXT_SOUND
+  // The chip is not attached, so its writes are not even queued
+  pSound = NULL;
+#endif
 
-APU_WRITEFUNC(Control, CTRL);
+  ApuExt = pSound;
+  ApuExtDivider = pSound ? std::max(1, (pSound->byCost + APU_EXT_BUDGET - 1) / APU_EXT_BUDGET) : 1;
+  ApuExtPhase = 0;
+
+  if (pSound)
+    pSound->Reset();
+}
+
+/* The register is queued as the type of the event */
+void InfoNES_pAPUExtWrite(BYTE byReg, BYTE byData)
+{
+  if (ApuExt)
+    ApuQueueEvent(APU_QUEUE_EXT, getCurrentClocks() - entertime, byReg, byData);
+}
 
 ApuWritefunc pAPUSoundRegs[20] =
     {
@@ -94,7 +158,9 @@ ApuWritefunc pAPUSoundRegs[20] =
 /*   APU resources                                                   */
 /*-------------------------------------------------------------------*/
 
+#if APU_CHANNEL_BUFFERS
 BYTE wave_buffers[5][735]; /* 44100 / 60 = 735 samples per sync */
+#endif
 
 BYTE ApuCtrl;
 BYTE ApuCtrlNew;
@@ -103,12 +169,13 @@ BYTE ApuCtrlNew;
 /*   APU Quality resources                                           */
 /*-------------------------------------------------------------------*/
 
-int ApuQuality;
+int ApuQuality = pAPU_QUALITY - 1;
 
 DWORD ApuPulseMagic;
 DWORD ApuTriangleMagic;
 DWORD ApuNoiseMagic;
 unsigned int ApuSamplesPerSync16;
+unsigned int ApuSamplesPerSyncAdj16;
 unsigned int ApuCyclesPerSample;
 unsigned int ApuSampleRate;
 DWORD ApuCycleRate;
@@ -122,21 +189,51 @@ struct ApuQualityData_t
   unsigned int cycles_per_sample;
   unsigned int sample_rate;
   DWORD cycle_rate;
-} ApuQual[] = {
-    // {0xa2567000, 0xa2567000, 0xa2567000, 183, 164, 11025, 1062658},
-    // {0x512b3800, 0x512b3800, 0x512b3800, 367, 82, 22050, 531329},
-    // {0x289d9c00, 0x289d9c00, 0x289d9c00, 735, 41, 44100, 265664},
-    {0xa2567000, 0xa2567000, 0xa2567000, 45963, 164, 11025, 664935},
-    {0x512b3800, 0x512b3800, 0x512b3800, 91926, 82, 22050, 1329870},
-    {0x289d9c00, 0x289d9c00, 0x289d9c00, 184402, 41, 44100, 2659741},
 };
 
-// 44100/60/262*65536 = 183850.99236641222
-// (44100*1.001)/60/262*65536 = 184034.84335877863
-// (44100*1.003)/60/262*65536 = 184402.54534351142
+/* CPU clock [Hz] and H-Syncs per second */
+#define APU_CPU_CLOCK 1789773
+#define APU_SYNC_PER_SEC (60 * 262)
+
+static constexpr ApuQualityData_t ApuMakeQuality(unsigned int rate)
+{
+  return {
+      /* An entry of the wave tables ( 1 << 24 ) per CPU clock */
+      (DWORD)(((uint64_t)APU_CPU_CLOCK << 24) / rate),
+      (DWORD)(((uint64_t)APU_CPU_CLOCK << 24) / rate),
+      (DWORD)(((uint64_t)APU_CPU_CLOCK << 24) / rate),
+      /* 0.3% more than rate / 60 / 262, not to run out while the display waits */
+      (unsigned int)(((uint64_t)rate * 1003 << 16) / (APU_SYNC_PER_SEC * 1000)),
+      (APU_CPU_CLOCK + rate - 1) / rate,
+      rate,
+      /* CPU clocks per sample [16.16] for the DPCM channel */
+      (DWORD)(((uint64_t)APU_CPU_CLOCK << 16) / rate),
+  };
+}
+
+static constexpr ApuQualityData_t ApuQual[] = {
+    ApuMakeQuality(32000),
+    ApuMakeQuality(44100),
+    ApuMakeQuality(48000),
+};
 
-// cycle_rate
+// (44100*1.003)/60/262*65536 = 184402.54534351142
+static_assert(ApuQual[1].samples_per_sync_16 == 184402, "samples per sync");
 // 1789773 / 44100 * 65536 = 2659740.665034014
+static_assert(ApuQual[1].cycle_rate == 2659740, "cycle rate");
+
+bool InfoNES_pAPUSetSampleRate(unsigned int nRate)
+{
+  for (int nIdx = 0; nIdx < (int)(sizeof ApuQual / sizeof ApuQual[0]); ++nIdx)
+  {
+    if (ApuQual[nIdx].sample_rate == nRate)
+    {
+      ApuQuality = nIdx;
+      return true;
+    }
+  }
+  return false;
+}
 
 /*-------------------------------------------------------------------*/
 /*  Rectangle Wave #1 resources                                      */
@@ -208,6 +305,18 @@ int ApuC5Phaseacc;
 WORD ApuC5Address, ApuC5CacheAddr;
 int ApuC5DmaLength, ApuC5CacheDmaLength;
 
+/* ROM page of ApuC5Address, NULL when it has to be resolved again */
+const BYTE *ApuC5Page;
+
+/*-------------------------------------------------------------------*/
+/*  Frame sequencer resources                                        */
+/*-------------------------------------------------------------------*/
+BYTE ApuFrameMode;    /* 0: 4-step, 1: 5-step sequence */
+BYTE ApuFrameInhibit; /* Frame interrupt inhibited */
+BYTE ApuFrameIrq;     /* Frame interrupt flag ( $4015 bit 6 ) */
+BYTE ApuFrameStep;    /* Next step of the sequence */
+int ApuFrameClocks;   /* Clocks of the sequence at the start of the line */
+
 /*-------------------------------------------------------------------*/
 /*  Wave Data                                                        */
 /*-------------------------------------------------------------------*/
@@ -394,42 +503,42 @@ BYTE *__not_in_flash_func(pulse_waves)[4] = {
 };
 
 /*-------------------------------------------------------------------*/
-/*  Active Time Left Data                                            */
+/*  Active Time Left Data ( in half frames )                         */
 /*-------------------------------------------------------------------*/
 BYTE __not_in_flash_func(ApuAtl)[0x20] =
     {
-        5,
-        127,
         10,
-        1,
-        19,
+        254,
+        20,
         2,
         40,
-        3,
-        80,
         4,
-        30,
-        5,
-        7,
-        6,
-        13,
-        7,
+        80,
         6,
+        160,
         8,
+        60,
+        10,
+        14,
+        12,
+        26,
+        14,
         12,
-        9,
+        16,
         24,
-        10,
+        18,
         48,
-        11,
+        20,
         96,
-        12,
-        36,
-        13,
-        8,
-        14,
+        22,
+        192,
+        24,
+        72,
+        26,
         16,
-        15,
+        28,
+        32,
+        30,
 };
 
 /*-------------------------------------------------------------------*/
@@ -468,23 +577,24 @@ DWORD __not_in_flash_func(ApuDpcmCycles)[16] =
 int __not_in_flash_func(ApuWriteWave1)(int cycles, int event)
 {
   /* APU Reg Write Event */
-  while ((event < cur_event) && (ApuEventQueue[event].time < cycles))
+  const struct ApuEventQueue_t &q = ApuEventQueue[0];
+  while ((event < q.count) && (q.event[event].time < cycles))
   {
-    if ((ApuEventQueue[event].type & APUET_MASK) == APUET_C1)
+    if (q.event[event].type != APUET_W_CTRL)
     {
-      switch (ApuEventQueue[event].type & 0x03)
+      switch (q.event[event].type & 0x03)
       {
       case 0:
-        ApuC1a = ApuEventQueue[event].data;
+        ApuC1a = q.event[event].data;
         ApuC1Wave = pulse_waves[ApuC1DutyCycle >> 6];
         break;
 
       case 1:
-        ApuC1b = ApuEventQueue[event].data;
+        ApuC1b = q.event[event].data;
         break;
 
       case 2:
-        ApuC1c = ApuEventQueue[event].data;
+        ApuC1c = q.event[event].data;
         ApuC1Freq = ((((WORD)ApuC1d & 0x07) << 8) + ApuC1c);
         ApuC1Atl = ApuAtl[(ApuC1d & 0xf8) >> 3];
 
@@ -499,7 +609,7 @@ int __not_in_flash_func(ApuWriteWave1)(int cycles, int event)
         break;
 
       case 3:
-        ApuC1d = ApuEventQueue[event].data;
+        ApuC1d = q.event[event].data;
         ApuC1Freq = ((((WORD)ApuC1d & 0x07) << 8) + ApuC1c);
         ApuC1Atl = ApuAtl[(ApuC1d & 0xf8) >> 3];
 
@@ -516,11 +626,11 @@ int __not_in_flash_func(ApuWriteWave1)(int cycles, int event)
         break;
       }
     }
-    else if (ApuEventQueue[event].type == APUET_W_CTRL)
+    else if (q.event[event].type == APUET_W_CTRL)
     {
-      ApuCtrlNew = ApuEventQueue[event].data;
+      ApuCtrlNew = q.event[event].data;
 
-      if (!(ApuEventQueue[event].data & (1 << 0)))
+      if (!(q.event[event].data & (1 << 0)))
       {
         ApuC1Atl = 0;
       }
@@ -534,28 +644,37 @@ int __not_in_flash_func(ApuWriteWave1)(int cycles, int event)
 /* Rendering rectangular wave #1                                     */
 /*-------------------------------------------------------------------*/
 
-void __not_in_flash_func(ApuRenderingWave1)(int n)
+static inline bool ApuIsOnWave1()
 {
-  ApuCtrlNew = ApuCtrl;
-  ApuWriteWave1(ApuCyclesPerSample * (n + 1), 0);
+  return (ApuCtrlNew & 0x01) && (ApuC1Atl || ApuC1Hold) &&
+         !(ApuC1Freq < 8 || (!ApuC1SweepIncDec && ApuC1Freq > ApuC1FreqLimit));
+}
+
+static inline BYTE ApuSampleWave1(BYTE vol)
+{
+  ApuC1Index += ApuC1Skip;
+  ApuC1Index &= 0x1fffffff;
+  return ApuC1Wave[ApuC1Index >> 24] * vol;
+}
 
-  if ((ApuCtrlNew & 0x01) && (ApuC1Atl || ApuC1Hold) &&
-      !(ApuC1Freq < 8 || (!ApuC1SweepIncDec && ApuC1Freq > ApuC1FreqLimit)))
+#if APU_CHANNEL_BUFFERS
+void __not_in_flash_func(ApuRenderingWave1)(int n)
+{
+  if (ApuIsOnWave1())
   {
     auto vol = ApuC1Env ? ApuC1Vol : ApuC1EnvVol;
     for (unsigned int i = 0; i < n; i++)
     {
       /* Wave Rendering */
-      ApuC1Index += ApuC1Skip;
-      ApuC1Index &= 0x1fffffff;
-      wave_buffers[0][i] = ApuC1Wave[ApuC1Index >> 24] * vol;
+      wave_buffers[0][i] = ApuSampleWave1(vol);
     }
   }
   else
   {
-    memset(wave_buffers[0], 0, 2 * n);
+    memset(wave_buffers[0], 0, n);
   }
 }
+#endif
 
 /*===================================================================*/
 /*                                                                   */
@@ -570,23 +689,24 @@ void __not_in_flash_func(ApuRenderingWave1)(int n)
 int __not_in_flash_func(ApuWriteWave2)(int cycles, int event)
 {
   /* APU Reg Write Event */
-  while ((event < cur_event) && (ApuEventQueue[event].time < cycles))
+  const struct ApuEventQueue_t &q = ApuEventQueue[1];
+  while ((event < q.count) && (q.event[event].time < cycles))
   {
-    if ((ApuEventQueue[event].type & APUET_MASK) == APUET_C2)
+    if (q.event[event].type != APUET_W_CTRL)
     {
-      switch (ApuEventQueue[event].type & 0x03)
+      switch (q.event[event].type & 0x03)
       {
       case 0:
-        ApuC2a = ApuEventQueue[event].data;
+        ApuC2a = q.event[event].data;
         ApuC2Wave = pulse_waves[ApuC2DutyCycle >> 6];
         break;
 
       case 1:
-        ApuC2b = ApuEventQueue[event].data;
+        ApuC2b = q.event[event].data;
         break;
 
       case 2:
-        ApuC2c = ApuEventQueue[event].data;
+        ApuC2c = q.event[event].data;
         ApuC2Freq = ((((WORD)ApuC2d & 0x07) << 8) + ApuC2c);
         ApuC2Atl = ApuAtl[(ApuC2d & 0xf8) >> 3];
 
@@ -601,7 +721,7 @@ int __not_in_flash_func(ApuWriteWave2)(int cycles, int event)
         break;
 
       case 3:
-        ApuC2d = ApuEventQueue[event].data;
+        ApuC2d = q.event[event].data;
         ApuC2Freq = ((((WORD)ApuC2d & 0x07) << 8) + ApuC2c);
         ApuC2Atl = ApuAtl[(ApuC2d & 0xf8) >> 3];
 
@@ -617,11 +737,11 @@ int __not_in_flash_func(ApuWriteWave2)(int cycles, int event)
         break;
       }
     }
-    else if (ApuEventQueue[event].type == APUET_W_CTRL)
+    else if (q.event[event].type == APUET_W_CTRL)
     {
-      ApuCtrlNew = ApuEventQueue[event].data;
+      ApuCtrlNew = q.event[event].data;
 
-      if (!(ApuEventQueue[event].data & (1 << 1)))
+      if (!(q.event[event].data & (1 << 1)))
       {
         ApuC2Atl = 0;
       }
@@ -635,28 +755,37 @@ int __not_in_flash_func(ApuWriteWave2)(int cycles, int event)
 /* Rendering rectangular wave #2                                     */
 /*-------------------------------------------------------------------*/
 
-void __not_in_flash_func(ApuRenderingWave2)(int n)
+static inline bool ApuIsOnWave2()
 {
-  ApuCtrlNew = ApuCtrl;
-  ApuWriteWave2(ApuCyclesPerSample * (n + 1), 0);
+  return (ApuCtrlNew & 0x02) && (ApuC2Atl || ApuC2Hold) &&
+         !(ApuC2Freq < 8 || (!ApuC2SweepIncDec && ApuC2Freq > ApuC2FreqLimit));
+}
 
-  if ((ApuCtrlNew & 0x02) && (ApuC2Atl || ApuC2Hold) &&
-      !(ApuC2Freq < 8 || (!ApuC2SweepIncDec && ApuC2Freq > ApuC2FreqLimit)))
+static inline BYTE ApuSampleWave2(BYTE vol)
+{
+  ApuC2Index += ApuC2Skip;
+  ApuC2Index &= 0x1fffffff;
+  return ApuC2Wave[ApuC2Index >> 24] * vol;
+}
+
+#if APU_CHANNEL_BUFFERS
+void __not_in_flash_func(ApuRenderingWave2)(int n)
+{
+  if (ApuIsOnWave2())
   {
     auto vol = ApuC2Env ? ApuC2Vol : ApuC2EnvVol;
     for (unsigned int i = 0; i < n; i++)
     {
       /* Wave Rendering */
-      ApuC2Index += ApuC2Skip;
-      ApuC2Index &= 0x1fffffff;
-      wave_buffers[1][i] = ApuC2Wave[ApuC2Index >> 24] * vol;
+      wave_buffers[1][i] = ApuSampleWave2(vol);
     }
   }
   else
   {
-    memset(wave_buffers[1], 0, 2 * n);
+    memset(wave_buffers[1], 0, n);
   }
 }
+#endif
 
 /*===================================================================*/
 /*                                                                   */
@@ -671,22 +800,23 @@ void __not_in_flash_func(ApuRenderingWave2)(int n)
 int __not_in_flash_func(ApuWriteWave3)(int cycles, int event)
 {
   /* APU Reg Write Event */
-  while ((event < cur_event) && (ApuEventQueue[event].time < cycles))
+  const struct ApuEventQueue_t &q = ApuEventQueue[2];
+  while ((event < q.count) && (q.event[event].time < cycles))
   {
-    if ((ApuEventQueue[event].type & APUET_MASK) == APUET_C3)
+    if (q.event[event].type != APUET_W_CTRL)
     {
-      switch (ApuEventQueue[event].type & 3)
+      switch (q.event[event].type & 3)
       {
       case 0:
-        ApuC3a = ApuEventQueue[event].data;
+        ApuC3a = q.event[event].data;
         break;
 
       case 1:
-        ApuC3b = ApuEventQueue[event].data;
+        ApuC3b = q.event[event].data;
         break;
 
       case 2:
-        ApuC3c = ApuEventQueue[event].data;
+        ApuC3c = q.event[event].data;
         if (ApuC3Freq)
         {
           ApuC3Skip = ApuTriangleMagic / ApuC3Freq;
@@ -698,7 +828,7 @@ int __not_in_flash_func(ApuWriteWave3)(int cycles, int event)
         break;
 
       case 3:
-        ApuC3d = ApuEventQueue[event].data;
+        ApuC3d = q.event[event].data;
         ApuC3Atl = ApuC3LengthCounter;
         ApuC3ReloadFlag = true;
         if (ApuC3Freq)
@@ -711,11 +841,11 @@ int __not_in_flash_func(ApuWriteWave3)(int cycles, int event)
         }
       }
     }
-    else if (ApuEventQueue[event].type == APUET_W_CTRL)
+    else if (q.event[event].type == APUET_W_CTRL)
     {
-      ApuCtrlNew = ApuEventQueue[event].data;
+      ApuCtrlNew = q.event[event].data;
 
-      if (!(ApuEventQueue[event].data & (1 << 2)))
+      if (!(q.event[event].data & (1 << 2)))
       {
         ApuC3Atl = 0;
         ApuC3Llc = 0;
@@ -730,26 +860,35 @@ int __not_in_flash_func(ApuWriteWave3)(int cycles, int event)
 /* Rendering triangle wave #3                                        */
 /*-------------------------------------------------------------------*/
 
-void __not_in_flash_func(ApuRenderingWave3)(int n)
+static inline bool ApuIsOnWave3()
 {
-  ApuCtrlNew = ApuCtrl;
-  ApuWriteWave3(ApuCyclesPerSample * (n + 1), 0);
+  return (ApuCtrlNew & 0x04) && ApuC3Atl > 0 && ApuC3Llc > 0 && ApuC3Freq >= 8;
+}
 
-  if ((ApuCtrlNew & 0x04) && ApuC3Atl > 0 && ApuC3Llc > 0 && ApuC3Freq >= 8)
+static inline BYTE ApuSampleWave3()
+{
+  ApuC3Index += ApuC3Skip;
+  ApuC3Index &= 0x1fffffff;
+  return triangle_50[ApuC3Index >> 24];
+}
+
+#if APU_CHANNEL_BUFFERS
+void __not_in_flash_func(ApuRenderingWave3)(int n)
+{
+  if (ApuIsOnWave3())
   {
     for (unsigned int i = 0; i < n; i++)
     {
       /* Wave Rendering */
-      ApuC3Index += ApuC3Skip;
-      ApuC3Index &= 0x1fffffff;
-      wave_buffers[2][i] = triangle_50[ApuC3Index >> 24];
+      wave_buffers[2][i] = ApuSampleWave3();
     }
   }
   else
   {
-    memset(wave_buffers[2], 0, 2 * n);
+    memset(wave_buffers[2], 0, n);
   }
 }
+#endif
 
 /*===================================================================*/
 /*                                                                   */
@@ -764,22 +903,23 @@ void __not_in_flash_func(ApuRenderingWave3)(int n)
 int __not_in_flash_func(ApuWriteWave4)(int cycles, int event)
 {
   /* APU Reg Write Event */
-  while ((event < cur_event) && (ApuEventQueue[event].time < cycles))
+  const struct ApuEventQueue_t &q = ApuEventQueue[3];
+  while ((event < q.count) && (q.event[event].time < cycles))
   {
-    if ((ApuEventQueue[event].type & APUET_MASK) == APUET_C4)
+    if (q.event[event].type != APUET_W_CTRL)
     {
-      switch (ApuEventQueue[event].type & 3)
+      switch (q.event[event].type & 3)
       {
       case 0:
-        ApuC4a = ApuEventQueue[event].data;
+        ApuC4a = q.event[event].data;
         break;
 
       case 1:
-        ApuC4b = ApuEventQueue[event].data;
+        ApuC4b = q.event[event].data;
         break;
 
       case 2:
-        ApuC4c = ApuEventQueue[event].data;
+        ApuC4c = q.event[event].data;
 
         // if (ApuC4Small)
         // {
@@ -803,7 +943,7 @@ int __not_in_flash_func(ApuWriteWave4)(int cycles, int event)
         break;
 
       case 3:
-        ApuC4d = ApuEventQueue[event].data;
+        ApuC4d = q.event[event].data;
 
         /* Frequency */
         if (ApuC4Freq)
@@ -818,11 +958,11 @@ int __not_in_flash_func(ApuWriteWave4)(int cycles, int event)
         ApuC4EnvVol = 15;
       }
     }
-    else if (ApuEventQueue[event].type == APUET_W_CTRL)
+    else if (q.event[event].type == APUET_W_CTRL)
     {
-      ApuCtrlNew = ApuEventQueue[event].data;
+      ApuCtrlNew = q.event[event].data;
 
-      if (!(ApuEventQueue[event].data & (1 << 3)))
+      if (!(q.event[event].data & (1 << 3)))
       {
         ApuC4Atl = 0;
       }
@@ -836,48 +976,44 @@ int __not_in_flash_func(ApuWriteWave4)(int cycles, int event)
 /* Rendering noise channel #4                                        */
 /*-------------------------------------------------------------------*/
 
-void __not_in_flash_func(ApuRenderingWave4)(int n)
+static inline bool ApuIsOnWave4()
 {
-  ApuCtrlNew = ApuCtrl;
-  ApuWriteWave4(ApuCyclesPerSample * (n + 1), 0);
+  return (ApuCtrlNew & 0x08) && ApuC4Atl;
+}
 
-  if ((ApuCtrlNew & 0x08) && ApuC4Atl)
+static inline BYTE ApuSampleWave4(int shift, BYTE vol)
+{
+  ApuC4Index += ApuC4Skip;
+  if (ApuC4Index > 0xffffff)
+  {
+    int f = (ApuC4Sr ^ (ApuC4Sr >> shift)) & 1;
+    ApuC4Sr = (ApuC4Sr >> 1) | (f << 14);
+
+    ApuC4Index &= 0xffffff;
+  }
+
+  return (ApuC4Sr & 1) ? 0 : vol;
+}
+
+#if APU_CHANNEL_BUFFERS
+void __not_in_flash_func(ApuRenderingWave4)(int n)
+{
+  if (ApuIsOnWave4())
   {
     int shift = ApuC4Small ? 6 : 1;
+    BYTE vol = ApuC4Env ? ApuC4Vol : ApuC4EnvVol;
     for (unsigned int i = 0; i < n; i++)
     {
       /* Wave Rendering */
-      ApuC4Index += ApuC4Skip;
-      if (ApuC4Index > 0xffffff)
-      {
-        int f = (ApuC4Sr ^ (ApuC4Sr >> shift)) & 1;
-        ApuC4Sr = (ApuC4Sr >> 1) | (f << 14);
-
-        ApuC4Index &= 0xffffff;
-      }
-
-      if (!(ApuC4Sr & 1))
-      {
-        if (ApuC4Env)
-        {
-          wave_buffers[3][i] = ApuC4Vol;
-        }
-        else
-        {
-          wave_buffers[3][i] = ApuC4EnvVol;
-        }
-      }
-      else
-      {
-        wave_buffers[3][i] = 0;
-      }
+      wave_buffers[3][i] = ApuSampleWave4(shift, vol);
     }
   }
   else
   {
-    memset(wave_buffers[3], 0, n << 1);
+    memset(wave_buffers[3], 0, n);
   }
 }
+#endif
 
 /*===================================================================*/
 /*                                                                   */
@@ -891,35 +1027,39 @@ void __not_in_flash_func(ApuRenderingWave4)(int n)
 
 int __not_in_flash_func(ApuWriteWave5)(int cycles, int event)
 {
+  /* The CPU may have switched the ROM banks since the last H-Sync */
+  ApuC5Page = NULL;
+
   /* APU Reg Write Event */
-  while ((event < cur_event) && (ApuEventQueue[event].time < cycles))
+  const struct ApuEventQueue_t &q = ApuEventQueue[4];
+  while ((event < q.count) && (q.event[event].time < cycles))
   {
-    if ((ApuEventQueue[event].type & APUET_MASK) == APUET_C5)
+    if (q.event[event].type != APUET_W_CTRL)
     {
-      ApuC5Reg[ApuEventQueue[event].type & 3] = ApuEventQueue[event].data;
+      ApuC5Reg[q.event[event].type & 3] = q.event[event].data;
 
-      switch (ApuEventQueue[event].type & 3)
+      switch (q.event[event].type & 3)
       {
       case 0:
-        ApuC5Freq = ApuDpcmCycles[(ApuEventQueue[event].data & 0x0F)] << 16;
-        ApuC5Looping = ApuEventQueue[event].data & 0x40;
+        ApuC5Freq = ApuDpcmCycles[(q.event[event].data & 0x0F)] << 16;
+        ApuC5Looping = q.event[event].data & 0x40;
         break;
       case 1:
-        ApuC5DpcmValue = (ApuEventQueue[event].data & 0x7F) >> 1;
+        ApuC5DpcmValue = (q.event[event].data & 0x7F) >> 1;
         break;
       case 2:
-        ApuC5CacheAddr = 0xC000 + (WORD)(ApuEventQueue[event].data << 6);
+        ApuC5CacheAddr = 0xC000 + (WORD)(q.event[event].data << 6);
         break;
       case 3:
-        ApuC5CacheDmaLength = ((ApuEventQueue[event].data << 4) + 1) << 3;
+        ApuC5CacheDmaLength = ((q.event[event].data << 4) + 1) << 3;
         break;
       }
     }
-    else if (ApuEventQueue[event].type == APUET_W_CTRL)
+    else if (q.event[event].type == APUET_W_CTRL)
     {
-      ApuCtrlNew = ApuEventQueue[event].data;
+      ApuCtrlNew = q.event[event].data;
 
-      if (!(ApuEventQueue[event].data & (1 << 4)))
+      if (!(q.event[event].data & (1 << 4)))
       {
         ApuC5Enable = 0;
         ApuC5DmaLength = 0;
@@ -931,6 +1071,7 @@ int __not_in_flash_func(ApuWriteWave5)(int cycles, int event)
         {
           ApuC5Address = ApuC5CacheAddr;
           ApuC5DmaLength = ApuC5CacheDmaLength;
+          ApuC5Page = NULL;
         }
       }
     }
@@ -943,129 +1084,562 @@ int __not_in_flash_func(ApuWriteWave5)(int cycles, int event)
 /* Rendering DPCM channel #5                                         */
 /*-------------------------------------------------------------------*/
 
-void __not_in_flash_func(ApuRenderingWave5)(int n)
+static inline bool ApuIsOnWave5()
 {
-  ApuCtrlNew = ApuCtrl;
-  ApuWriteWave5(ApuCyclesPerSample * (n + 1), 0);
+  return ApuCtrlNew & 0x10;
+}
+
+/*-------------------------------------------------------------------*/
+/*  The sample is read straight from the ROM bank, the page being    */
+/*  resolved once per 8KB instead of a CPU bus read per byte.        */
+/*-------------------------------------------------------------------*/
+static inline BYTE ApuFetchWave5()
+{
+  if (!ApuC5Page)
+    ApuC5Page = ROMBANK[((ApuC5Address - 0x8000) >> 13) & 3];
+
+  BYTE byData = ApuC5Page[ApuC5Address & 0x1fff];
 
-  if (ApuCtrlNew & 0x10)
+  if (0xFFFF == ApuC5Address)
+    ApuC5Address = 0x8000;
+  else
+    ApuC5Address++;
+
+  // Crossed into the next page
+  if (!(ApuC5Address & 0x1fff))
+    ApuC5Page = NULL;
+
+  return byData;
+}
+
+static inline BYTE ApuSampleWave5()
+{
+  if (ApuC5DmaLength)
   {
-    for (unsigned int i = 0; i < n; i++)
+    ApuC5Phaseacc -= ApuCycleRate;
+
+    while (ApuC5Phaseacc < 0)
     {
-      if (ApuC5DmaLength)
+      ApuC5Phaseacc += ApuC5Freq;
+      if (!(ApuC5DmaLength & 7))
       {
-        ApuC5Phaseacc -= ApuCycleRate;
-
-        while (ApuC5Phaseacc < 0)
+        ApuC5CurByte = ApuFetchWave5();
+      }
+      if (!(--ApuC5DmaLength))
+      {
+        if (ApuC5Looping)
         {
-          ApuC5Phaseacc += ApuC5Freq;
-          if (!(ApuC5DmaLength & 7))
-          {
-            ApuC5CurByte = K6502_Read(ApuC5Address);
-            if (0xFFFF == ApuC5Address)
-              ApuC5Address = 0x8000;
-            else
-              ApuC5Address++;
-          }
-          if (!(--ApuC5DmaLength))
-          {
-            if (ApuC5Looping)
-            {
-              ApuC5Address = ApuC5CacheAddr;
-              ApuC5DmaLength = ApuC5CacheDmaLength;
-            }
-            else
-            {
-              ApuC5Enable = 0;
-              break;
-            }
-          }
-
-          // positive delta
-          if (ApuC5CurByte & (1 << ((ApuC5DmaLength & 7) ^ 7)))
-          {
-            if (ApuC5DpcmValue < 0x3F)
-              ApuC5DpcmValue += 1;
-          }
-          else
-          {
-            // negative delta
-            if (ApuC5DpcmValue > 1)
-              ApuC5DpcmValue -= 1;
-          }
+          ApuC5Address = ApuC5CacheAddr;
+          ApuC5DmaLength = ApuC5CacheDmaLength;
+          ApuC5Page = NULL;
         }
+        else
+        {
+          ApuC5Enable = 0;
+          break;
+        }
+      }
+
+      // positive delta
+      if (ApuC5CurByte & (1 << ((ApuC5DmaLength & 7) ^ 7)))
+      {
+        if (ApuC5DpcmValue < 0x3F)
+          ApuC5DpcmValue += 1;
+      }
+      else
+      {
+        // negative delta
+        if (ApuC5DpcmValue > 1)
+          ApuC5DpcmValue -= 1;
       }
+    }
+  }
+
+  return ApuC5DpcmValue;
+}
 
+#if APU_CHANNEL_BUFFERS
+void __not_in_flash_func(ApuRenderingWave5)(int n)
+{
+  if (ApuIsOnWave5())
+  {
+    for (unsigned int i = 0; i < n; i++)
+    {
       /* Wave Rendering */
-      wave_buffers[4][i] = ApuC5DpcmValue;
+      wave_buffers[4][i] = ApuSampleWave5();
     }
   }
   else
   {
-    memset(wave_buffers[4], 0, n << 1);
+    memset(wave_buffers[4], 0, n);
   }
 }
+#endif
 
 /*===================================================================*/
 /*                                                                   */
-/*     InfoNES_pApuVsync() : Callback Function per Vsync             */
+/*          ApuMix() : Mixing the channels to a stereo sample        */
 /*                                                                   */
 /*===================================================================*/
 
-void InfoNES_pAPUVsync()
+/*-------------------------------------------------------------------*/
+/*  The non-linear mixer of the APU                                  */
+/*    pulse = 95.88 / ( 8128 / ( pulse1 + pulse2 ) + 100 )           */
+/*    tnd   = 159.79 / ( 1 / ( triangle / 8227 + noise / 12241 +     */
+/*            dmc / 22638 ) + 100 )                                  */
+/*  approximated by the tables of pulse1 + pulse2 and                */
+/*  3 * triangle + 2 * noise + dmc, with an entry more for the       */
+/*  interpolation of the panned channels.                            */
+/*-------------------------------------------------------------------*/
+
+WORD __not_in_flash_func(ApuPulseTable)[31 + 1];
+WORD __not_in_flash_func(ApuTndTable)[203 + 1];
+
+/*-------------------------------------------------------------------*/
+/*  Panning of the channels ( APU_PAN_UNIT is through )              */
+/*  The channels are mixed for each side after they are panned.      */
+/*-------------------------------------------------------------------*/
+
+BYTE __not_in_flash_func(ApuPan)[APU_CHANNEL_MAX][2] = {
+    {APU_PAN_UNIT, APU_PAN_UNIT / 2}, /* Pulse #1 a little to the left */
+    {APU_PAN_UNIT / 2, APU_PAN_UNIT}, /* Pulse #2 a little to the right */
+    {APU_PAN_UNIT, APU_PAN_UNIT},
+    {APU_PAN_UNIT, APU_PAN_UNIT},
+    {APU_PAN_UNIT, APU_PAN_UNIT},
+};
+
+static void ApuMixInit()
 {
-  if (ApuC1Atl)
+  for (int n = 0; n < 31 + 1; ++n)
   {
-    ApuC1Atl--;
+    ApuPulseTable[n] = n ? (WORD)(APU_MIX_SCALE * 95.52 / (8128.0 / n + 100) + 0.5) : 0;
   }
-
-  /* Envelope decay at a rate of ( Envelope Delay + 1 ) / 240 secs */
-  ApuC1EnvPhase -= 4;
-  while (ApuC1EnvPhase < 0)
+  for (int n = 0; n < 203 + 1; ++n)
   {
-    ApuC1EnvPhase += ApuC1EnvDelay;
 
-    if (ApuC1Hold)
+    ApuTndTable[n] = n ? (WORD)(APU_MIX_SCALE * 163.67 / (24329.0 / n + 100) + 0.5) : 0;
+  }
+}
+
+/* Look up a table by an index in 1 / APU_PAN_UNIT */
+static inline int ApuMixLookup(const WORD *table, int index)
+{
+  const WORD *p = &table[index / APU_PAN_UNIT];
+  return p[0] + (((p[1] - p[0]) * (index % APU_PAN_UNIT)) / APU_PAN_UNIT);
+}
+
+/* Mix the amplitudes of the channels ( pulse, triangle and noise 0 - 15, dmc 0 - 127 ) */
+static inline void ApuMix(const BYTE *amp, int *pnLeft, int *pnRight)
+{
+  *pnLeft = ApuMixLookup(ApuPulseTable, amp[0] * ApuPan[0][0] + amp[1] * ApuPan[1][0]) +
+            ApuMixLookup(ApuTndTable, 3 * amp[2] * ApuPan[2][0] + 2 * amp[3] * ApuPan[3][0] + amp[4] * ApuPan[4][0]);
+  *pnRight = ApuMixLookup(ApuPulseTable, amp[0] * ApuPan[0][1] + amp[1] * ApuPan[1][1]) +
+             ApuMixLookup(ApuTndTable, 3 * amp[2] * ApuPan[2][1] + 2 * amp[3] * ApuPan[3][1] + amp[4] * ApuPan[4][1]);
+}
+
+void __not_in_flash_func(InfoNES_pAPUMix)(const BYTE *pbyAmp, short *pnLeft, short *pnRight)
+{
+  int nLeft, nRight;
+  ApuMix(pbyAmp, &nLeft, &nRight);
+  *pnLeft = nLeft;
+  *pnRight = nRight;
+}
+
+void InfoNES_pAPUSetPan(int ch, BYTE byLeft, BYTE byRight)
+{
+  ApuPan[ch][0] = std::min<int>(byLeft, APU_PAN_UNIT);
+  ApuPan[ch][1] = std::min<int>(byRight, APU_PAN_UNIT);
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*      ApuBlip*() : Band-limited synthesis of the mixed channels    */
+/*                                                                   */
+/*===================================================================*/
+
+#if !APU_CHANNEL_BUFFERS
+
+/*-------------------------------------------------------------------*/
+/*  The channels give the changes of their amplitude at the time in  */
+/*  a sync ( 16.16 samples ) they happen. Each change is added as    */
+/*  the differences of a band-limited step to a buffer, which is     */
+/*  integrated into the output samples.                              */
+/*-------------------------------------------------------------------*/
+
+#define APU_BLIP_TAPS 16       /* Width of a step [samples] */
+#define APU_BLIP_PHASE_BITS 5  /* Positions of a step between samples */
+#define APU_BLIP_PHASES (1 << APU_BLIP_PHASE_BITS)
+#define APU_BLIP_BITS 15       /* Fixed point of the steps */
+#define APU_BLIP_SIZE 64       /* Samples of a sync and the tail of the steps */
+
+/* Skip of the noise from which it is stepped by samples ( a shift per sample ) */
+#define APU_BLIP_NOISE_STEPPED (1 << 24)
+
+/* Differences of a band-limited step at each position between samples */
+static short ApuBlipKernel[APU_BLIP_PHASES][APU_BLIP_TAPS];
+
+/* Differences of the left and right outputs ( a ring ) and their sums */
+static int32_t ApuBlipL[APU_BLIP_SIZE];
+static int32_t ApuBlipR[APU_BLIP_SIZE];
+static int ApuBlipPos;
+static int32_t ApuBlipSumL, ApuBlipSumR;
+
+/* Amplitude of each channel given to the buffer ( native units ) */
+static BYTE ApuBlipLevel[APU_CHANNEL_MAX];
+
+/* Mixed output given to the buffer */
+static int ApuBlipOutL, ApuBlipOutR;
+
+/* Output of the expansion sound given to the buffer */
+static int ApuBlipExtLevel;
+
+/* Samples between the steps of the channels [16.16] and their skips */
+static uint32_t ApuBlipPeriod[APU_CHANNEL_MAX];
+static DWORD ApuBlipSkip[APU_CHANNEL_MAX];
+
+static void ApuBlipInit()
+{
+  const double pi = 3.14159265358979323846;
+
+  // Hann windowed sinc, cut off a little below the Nyquist frequency
+  for (int phase = 0; phase < APU_BLIP_PHASES; ++phase)
+  {
+    double taps[APU_BLIP_TAPS];
+    double sum = 0;
+    for (int k = 0; k < APU_BLIP_TAPS; ++k)
     {
-      ApuC1EnvVol = (ApuC1EnvVol - 1) & 0x0f;
+      double x = k - (APU_BLIP_TAPS / 2 - 1) - (double)phase / APU_BLIP_PHASES;
+      double a = 0.9 * pi * x;
+      taps[k] = (a == 0 ? 1.0 : sin(a) / a) * (0.5 + 0.5 * cos(pi * x / (APU_BLIP_TAPS / 2)));
+      sum += taps[k];
     }
-    else if (ApuC1EnvVol > 0)
+
+    // A step adds up to exactly 1 << APU_BLIP_BITS, so the sums never drift
+    int total = 0;
+    for (int k = 0; k < APU_BLIP_TAPS; ++k)
     {
-      --ApuC1EnvVol;
+      ApuBlipKernel[phase][k] = (short)floor(taps[k] / sum * (1 << APU_BLIP_BITS) + 0.5);
+      total += ApuBlipKernel[phase][k];
     }
+    ApuBlipKernel[phase][APU_BLIP_TAPS / 2 - 1] += (1 << APU_BLIP_BITS) - total;
   }
 
-  /* Frequency sweeping at a rate of ( Sweep Delay + 1) / 120 secs */
-  if (ApuC1SweepOn && ApuC1SweepShifts)
+  memset(ApuBlipL, 0, sizeof ApuBlipL);
+  memset(ApuBlipR, 0, sizeof ApuBlipR);
+  memset(ApuBlipLevel, 0, sizeof ApuBlipLevel);
+  ApuBlipOutL = ApuBlipOutR = 0;
+  ApuBlipExtLevel = 0;
+  memset(ApuBlipSkip, 0, sizeof ApuBlipSkip);
+  ApuBlipPos = 0;
+  ApuBlipSumL = ApuBlipSumR = 0;
+}
+
+/* Add a band-limited step of the output at a time in the sync */
+static inline void ApuBlipStep(int time, int deltaL, int deltaR)
+{
+  const short *kernel = ApuBlipKernel[(time >> (16 - APU_BLIP_PHASE_BITS)) & (APU_BLIP_PHASES - 1)];
+  int pos = ApuBlipPos + (time >> 16);
+  for (int k = 0; k < APU_BLIP_TAPS; ++k)
   {
-    ApuC1SweepPhase -= 2; /* 120/60 */
-    while (ApuC1SweepPhase < 0)
-    {
-      ApuC1SweepPhase += ApuC1SweepDelay;
+    int idx = (pos + k) & (APU_BLIP_SIZE - 1);
+    ApuBlipL[idx] += kernel[k] * deltaL;
+    ApuBlipR[idx] += kernel[k] * deltaR;
+  }
+}
 
-      if (ApuC1SweepIncDec) /* ramp up */
-      {
-        /* Rectangular #1 */
-        ApuC1Freq += ~(ApuC1Freq >> ApuC1SweepShifts);
-      }
-      else
+/* Change the amplitude of a channel and get the change of the output */
+static inline bool ApuBlipChange(int ch, BYTE amp, int *pnDeltaL, int *pnDeltaR)
+{
+  if (amp == ApuBlipLevel[ch])
+    return false;
+  ApuBlipLevel[ch] = amp;
+
+  // The mixer is not linear, so the change of the whole mix is added
+  int outL, outR;
+  ApuMix(ApuBlipLevel, &outL, &outR);
+  *pnDeltaL = outL - ApuBlipOutL;
+  *pnDeltaR = outR - ApuBlipOutR;
+  ApuBlipOutL = outL;
+  ApuBlipOutR = outR;
+  return true;
+}
+
+/* Change the amplitude of a channel at a time in the sync */
+static inline void ApuBlipAdd(int time, int ch, BYTE amp)
+{
+  int deltaL, deltaR;
+  if (ApuBlipChange(ch, amp, &deltaL, &deltaR))
+    ApuBlipStep(time, deltaL, deltaR);
+}
+
+/* Change the amplitude of a channel at a sample, not band-limited ( a tap at the middle of the steps ) */
+static inline void ApuBlipAddStepped(int i, int ch, BYTE amp)
+{
+  int deltaL, deltaR;
+  if (ApuBlipChange(ch, amp, &deltaL, &deltaR))
+  {
+    int idx = (ApuBlipPos + i + APU_BLIP_TAPS / 2 - 1) & (APU_BLIP_SIZE - 1);
+    ApuBlipL[idx] += deltaL * (1 << APU_BLIP_BITS);
+    ApuBlipR[idx] += deltaR * (1 << APU_BLIP_BITS);
+  }
+}
+
+/* Change the output of the expansion sound at a sample, which is mixed linearly */
+static inline void ApuBlipAddExt(int i, int level)
+{
+  if (level == ApuBlipExtLevel)
+    return;
+
+  int idx = (ApuBlipPos + i + APU_BLIP_TAPS / 2 - 1) & (APU_BLIP_SIZE - 1);
+  ApuBlipL[idx] += (level - ApuBlipExtLevel) * (1 << APU_BLIP_BITS);
+  ApuBlipR[idx] += (level - ApuBlipExtLevel) * (1 << APU_BLIP_BITS);
+  ApuBlipExtLevel = level;
+}
+
+
+/* Samples between the steps of a channel, divided only when its skip changes */
+static inline uint32_t ApuBlipStepPeriod(int ch, DWORD skip)
+{
+  if (skip != ApuBlipSkip[ch])
+  {
+    ApuBlipSkip[ch] = skip;
+    ApuBlipPeriod[ch] = std::min<uint64_t>(((uint64_t)1 << 40) / skip, 1u << 30);
+  }
+  return ApuBlipPeriod[ch];
+}
+
+/* Steps of a wave table of 32 entries ( 0x00 - 0xf0 ), stepped by index ( 5.24 ) */
+static void __not_in_flash_func(ApuBlipWave)(int ch, DWORD &index, DWORD skip, const BYTE *wave, BYTE vol, bool on, int n)
+{
+  ApuBlipAdd(0, ch, on ? (wave[index >> 24] >> 4) * vol : 0);
+  if (!on || !skip)
+    return;
+
+  // Samples between the entries and until the next entry [16.16]
+  uint32_t period = ApuBlipStepPeriod(ch, skip);
+  uint32_t time = ((((uint64_t)1 << 24) - (index & 0xffffff)) * period) >> 24;
+
+  // Only the entries changing the amplitude cost a step
+  int entry = index >> 24;
+  for (; time < (uint32_t)n << 16; time += period)
+  {
+    entry = (entry + 1) & 31;
+    ApuBlipAdd(time, ch, (wave[entry] >> 4) * vol);
+  }
+
+  index = (index + skip * n) & 0x1fffffff;
+}
+
+/* Triangle stepped by samples : its harmonics fall off fast, so the aliases
+   are weak, and it changes at every entry of its wave, up to every sample */
+static void __not_in_flash_func(ApuBlipTriangle)(bool on, int n)
+{
+  if (!on)
+  {
+    ApuBlipAddStepped(0, 2, 0);
+    return;
+  }
+
+  for (int i = 0; i < n; i++)
+    ApuBlipAddStepped(i, 2, ApuSampleWave3() >> 4);
+}
+
+/* Shifts of the noise register, a shift every time index ( 0.24 ) wraps */
+static void __not_in_flash_func(ApuBlipNoise)(bool on, int n)
+{
+  const BYTE vol = ApuC4Env ? ApuC4Vol : ApuC4EnvVol;
+  const int shift = ApuC4Small ? 6 : 1;
+
+  // A shift or more per sample is stepped by samples, as the steps would
+  // cost more than the samples and the noise is white up to the Nyquist
+  // frequency anyway
+  if (on && ApuC4Skip >= APU_BLIP_NOISE_STEPPED)
+  {
+    for (int i = 0; i < n; i++)
+    {
+      for (ApuC4Index += ApuC4Skip; ApuC4Index > 0xffffff; ApuC4Index -= 0x1000000)
       {
-        /* ramp down */
-        ApuC1Freq += (ApuC1Freq >> ApuC1SweepShifts);
+        int f = (ApuC4Sr ^ (ApuC4Sr >> shift)) & 1;
+        ApuC4Sr = (ApuC4Sr >> 1) | (f << 14);
       }
+      ApuBlipAddStepped(i, 3, (ApuC4Sr & 1) ? 0 : vol);
+    }
+    return;
+  }
+
+  ApuBlipAdd(0, 3, on && !(ApuC4Sr & 1) ? vol : 0);
+  if (!on || !ApuC4Skip)
+    return;
 
-      ApuC1Skip = ApuPulseMagic / (ApuC1Freq / 2);
+  uint32_t period = ApuBlipStepPeriod(3, ApuC4Skip);
+  uint32_t time = ((((uint64_t)1 << 24) - (ApuC4Index & 0xffffff)) * period) >> 24;
+
+  for (; time < (uint32_t)n << 16; time += period)
+  {
+    int f = (ApuC4Sr ^ (ApuC4Sr >> shift)) & 1;
+    ApuC4Sr = (ApuC4Sr >> 1) | (f << 14);
+    ApuBlipAdd(time, 3, (ApuC4Sr & 1) ? 0 : vol);
+  }
+
+  ApuC4Index = (ApuC4Index + ApuC4Skip * n) & 0xffffff;
+}
+
+/* Integrate the samples of the sync to the system */
+static void __not_in_flash_func(ApuBlipRead)(int n)
+{
+  int i = 0;
+  while (i < n)
+  {
+    // The ring buffer of the system may wrap around
+    short *pSamples;
+    int count = InfoNES_SoundLockSamples(&pSamples, n - i);
+    if (!count)
+      break;
+
+    for (int k = 0; k < count; ++k)
+    {
+      int idx = (ApuBlipPos + i + k) & (APU_BLIP_SIZE - 1);
+      ApuBlipSumL += ApuBlipL[idx];
+      ApuBlipSumR += ApuBlipR[idx];
+      ApuBlipL[idx] = ApuBlipR[idx] = 0;
+      *pSamples++ = ApuBlipSumL >> APU_BLIP_BITS;
+      *pSamples++ = ApuBlipSumR >> APU_BLIP_BITS;
     }
+
+    InfoNES_SoundUnlockSamples(count);
+    i += count;
   }
 
-  if (ApuC2Atl)
+  // Samples the system had no room for are dropped after the sums
+  for (; i < n; ++i)
   {
-    ApuC2Atl--;
+    int idx = (ApuBlipPos + i) & (APU_BLIP_SIZE - 1);
+    ApuBlipSumL += ApuBlipL[idx];
+    ApuBlipSumR += ApuBlipR[idx];
+    ApuBlipL[idx] = ApuBlipR[idx] = 0;
+  }
+
+  ApuBlipPos = (ApuBlipPos + n) & (APU_BLIP_SIZE - 1);
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*      ApuRenderingMix() : Rendering and mixing all the channels    */
+/*                                                                   */
+/*===================================================================*/
+
+void __not_in_flash_func(ApuRenderingMix)(int n, bool enabled)
+{
+  /*
+ *  Render the channels and mix them to the stereo samples of the system
+ *
+ *  Remarks
+ *    The pulse channels and the noise below a shift per sample cost a
+ *    band-limited step per change of their wave, not per sample
+ *    ( ApuBlipAdd() ). A step is a 16-tap kernel of both sides and a
+ *    mix, so the triangle, the faster noise and the DPCM channel are
+ *    stepped by samples at a tap each ( ApuBlipAddStepped() ). The
+ *    channels are mixed by ApuMix(). The expansion sound is rendered
+ *    by samples ( or a few at once within APU_EXT_BUDGET ) and added
+ *    linearly at a tap as well.
+ */
+
+  bool on1 = false, on2 = false, on3 = false, on4 = false, on5 = false;
+
+  if (enabled)
+  {
+    on1 = ApuIsOnWave1();
+    on2 = ApuIsOnWave2();
+    on3 = ApuIsOnWave3();
+    on4 = ApuIsOnWave4();
+    on5 = ApuIsOnWave5();
   }
 
+  // The steps of the sync have to fit in the buffer
+  n = std::min<int>(n, APU_BLIP_SIZE - APU_BLIP_TAPS);
+
+  ApuBlipWave(0, ApuC1Index, ApuC1Skip, ApuC1Wave, ApuC1Env ? ApuC1Vol : ApuC1EnvVol, on1, n);
+  ApuBlipWave(1, ApuC2Index, ApuC2Skip, ApuC2Wave, ApuC2Env ? ApuC2Vol : ApuC2EnvVol, on2, n);
+  ApuBlipTriangle(on3, n);
+  ApuBlipNoise(on4, n);
+  for (int i = 0; i < n; i++)
+    ApuBlipAddStepped(i, 4, on5 ? ApuSampleWave5() * 2 : 0);
+
+  if (ApuExt)
+  {
+    for (int i = 0; i < n; i++)
+    {
+      if (++ApuExtPhase < ApuExtDivider)
+        continue;
+      ApuExtPhase = 0;
+
+      int level = ApuExt->Render(ApuExtDivider);
+      ApuBlipAddExt(i, enabled ? level : 0);
+    }
+  }
+
+  ApuBlipRead(n);
+}
+#endif
+
+/*===================================================================*/
+/*                                                                   */
+/*      ApuRunLine() : Frame sequencer per Hsync                     */
+/*                                                                   */
+/*===================================================================*/
+
+/*-------------------------------------------------------------------*/
+/*  The sequences of $4017 in CPU clocks. A quarter frame clocks the */
+/*  envelopes and the linear counter, a half frame the length        */
+/*  counters and the sweeps too. The end of the 4-step sequence      */
+/*  sets the frame interrupt.                                        */
+/*-------------------------------------------------------------------*/
+
+#define APU_FRAME_QUARTER 0x01
+#define APU_FRAME_HALF 0x02
+#define APU_FRAME_IRQ 0x04
+
+struct ApuFrameStep_t
+{
+  WORD clocks;
+  BYTE flags;
+};
+
+static const struct ApuFrameStep_t __not_in_flash_func(ApuFrameSteps)[2][5] = {
+    {{7457, APU_FRAME_QUARTER},
+     {14913, APU_FRAME_QUARTER | APU_FRAME_HALF},
+     {22371, APU_FRAME_QUARTER},
+     {29829, APU_FRAME_QUARTER | APU_FRAME_HALF | APU_FRAME_IRQ}},
+    {{7457, APU_FRAME_QUARTER},
+     {14913, APU_FRAME_QUARTER | APU_FRAME_HALF},
+     {22371, APU_FRAME_QUARTER},
+     {29829, 0},
+     {37281, APU_FRAME_QUARTER | APU_FRAME_HALF}},
+};
+static const BYTE ApuFrameStepCount[2] = {4, 5};
+static const WORD ApuFramePeriod[2] = {29830, 37282};
+
+/*-------------------------------------------------------------------*/
+/*  Quarter frame                                                    */
+/*-------------------------------------------------------------------*/
+static void __not_in_flash_func(ApuQuarterFrame)()
+{
   /* Envelope decay at a rate of ( Envelope Delay + 1 ) / 240 secs */
-  ApuC2EnvPhase -= 4;
-  while (ApuC2EnvPhase < 0)
+  if (--ApuC1EnvPhase < 0)
+  {
+    ApuC1EnvPhase += ApuC1EnvDelay;
+
+    if (ApuC1Hold)
+    {
+      ApuC1EnvVol = (ApuC1EnvVol - 1) & 0x0f;
+    }
+    else if (ApuC1EnvVol > 0)
+    {
+      --ApuC1EnvVol;
+    }
+  }
+
+  if (--ApuC2EnvPhase < 0)
   {
     ApuC2EnvPhase += ApuC2EnvDelay;
 
@@ -1078,77 +1652,275 @@ void InfoNES_pAPUVsync()
       --ApuC2EnvVol;
     }
   }
-  //  printf("C2:%d:%d:%d\n", ApuC2Env, ApuC2EnvPhase, ApuC2EnvVol);
 
-  /* Frequency sweeping at a rate of ( Sweep Delay + 1) / 120 secs */
-  if (ApuC2SweepOn && ApuC2SweepShifts)
+  if (--ApuC4EnvPhase < 0)
   {
-    ApuC2SweepPhase -= 2; /* 120/60 */
-    while (ApuC2SweepPhase < 0)
-    {
-      ApuC2SweepPhase += ApuC2SweepDelay;
+    ApuC4EnvPhase += ApuC4EnvDelay;
 
-      if (ApuC2SweepIncDec) /* ramp up */
-      {
-        /* Rectangular #2 */
-        ApuC2Freq -= (ApuC2Freq >> ApuC2SweepShifts);
-      }
-      else
-      {
-        /* ramp down */
-        ApuC2Freq += (ApuC2Freq >> ApuC2SweepShifts);
-      }
-      ApuC2Skip = ApuPulseMagic / (ApuC2Freq / 2);
+    if (ApuC4Hold)
+    {
+      ApuC4EnvVol = (ApuC4EnvVol - 1) & 0x0f;
+    }
+    else if (ApuC4EnvVol > 0)
+    {
+      --ApuC4EnvVol;
     }
   }
 
+  /* Linear counter of the triangle */
   if (ApuC3ReloadFlag)
   {
     ApuC3Llc = ApuC3LinearLength;
   }
-  else
+  else if (ApuC3Llc > 0)
   {
-    if (ApuC3Llc > 0)
-    {
-      ApuC3Llc = std::max<int>(0, (int)ApuC3Llc - 4 * 64);
-    }
+    ApuC3Llc--;
   }
   if (!ApuC3Holdnote)
   {
     ApuC3ReloadFlag = false;
   }
+}
+
+/*-------------------------------------------------------------------*/
+/*  Half frame                                                       */
+/*-------------------------------------------------------------------*/
+static void __not_in_flash_func(ApuHalfFrame)()
+{
+  if (ApuC1Atl && !ApuC1Hold)
+  {
+    ApuC1Atl--;
+  }
+
+  /* Frequency sweeping at a rate of ( Sweep Delay + 1 ) / 120 secs */
+  if (ApuC1SweepOn && ApuC1SweepShifts && --ApuC1SweepPhase < 0)
+  {
+    ApuC1SweepPhase += ApuC1SweepDelay;
+
+    if (ApuC1SweepIncDec) /* ramp up */
+    {
+      /* Rectangular #1 */
+      ApuC1Freq += ~(ApuC1Freq >> ApuC1SweepShifts);
+    }
+    else
+    {
+      /* ramp down */
+      ApuC1Freq += (ApuC1Freq >> ApuC1SweepShifts);
+    }
+
+    ApuC1Skip = ApuC1Freq > 1 ? ApuPulseMagic / (ApuC1Freq / 2) : 0;
+  }
+
+  if (ApuC2Atl && !ApuC2Hold)
+  {
+    ApuC2Atl--;
+  }
+
+  if (ApuC2SweepOn && ApuC2SweepShifts && --ApuC2SweepPhase < 0)
+  {
+    ApuC2SweepPhase += ApuC2SweepDelay;
+
+    if (ApuC2SweepIncDec) /* ramp up */
+    {
+      /* Rectangular #2 */
+      ApuC2Freq -= (ApuC2Freq >> ApuC2SweepShifts);
+    }
+    else
+    {
+      /* ramp down */
+      ApuC2Freq += (ApuC2Freq >> ApuC2SweepShifts);
+    }
+
+    ApuC2Skip = ApuC2Freq > 1 ? ApuPulseMagic / (ApuC2Freq / 2) : 0;
+  }
 
   if (ApuC3Atl > 0 && !ApuC3Holdnote)
   {
     ApuC3Atl--;
   }
-  // printf("3: %d, %d, %d, %d\n", ApuC3Atl, ApuC3Llc, ApuC3Freq, ApuC3Holdnote);
 
   if (ApuC4Atl && !ApuC4Hold)
   {
     ApuC4Atl--;
   }
+}
 
-  /* Envelope decay at a rate of ( Envelope Delay + 1 ) / 240 secs */
-  ApuC4EnvPhase -= 4;
-  while (ApuC4EnvPhase < 0)
+static void __not_in_flash_func(ApuFrameClock)(BYTE flags)
+{
+  if (flags & APU_FRAME_QUARTER)
+    ApuQuarterFrame();
+  if (flags & APU_FRAME_HALF)
+    ApuHalfFrame();
+  if ((flags & APU_FRAME_IRQ) && !ApuFrameInhibit)
   {
-    ApuC4EnvPhase += ApuC4EnvDelay;
+    ApuFrameIrq = 0x40;
+    IRQ_REQ;
+  }
+}
 
-    if (ApuC4Hold)
+/*-------------------------------------------------------------------*/
+/*  Apply the register writes up to a time of the line              */
+/*-------------------------------------------------------------------*/
+static int __not_in_flash_func(ApuWriteExt)(int cycles, int event)
+{
+  const struct ApuEventQueue_t &q = ApuEventQueue[APU_QUEUE_EXT];
+  while ((event < q.count) && (q.event[event].time < cycles))
+  {
+    ApuExt->Write(q.event[event].type, q.event[event].data);
+    event++;
+  }
+  return event;
+}
+
+static void __not_in_flash_func(ApuWriteChannels)(int cycles, int *pEvents, bool enabled)
+{
+  if (!enabled)
+    return;
+
+  pEvents[0] = ApuWriteWave1(cycles, pEvents[0]);
+  pEvents[1] = ApuWriteWave2(cycles, pEvents[1]);
+  pEvents[2] = ApuWriteWave3(cycles, pEvents[2]);
+  pEvents[3] = ApuWriteWave4(cycles, pEvents[3]);
+  pEvents[4] = ApuWriteWave5(cycles, pEvents[4]);
+  if (ApuExt)
+    pEvents[APU_QUEUE_EXT] = ApuWriteExt(cycles, pEvents[APU_QUEUE_EXT]);
+}
+
+static void __not_in_flash_func(ApuRunLine)(int clocks, bool enabled)
+{
+/*
+ *  Run the frame sequencer over a line
+ *
+ *  Parameters
+ *    int clocks                (Read)
+ *      CPU clocks of the line
+ *
+ *    bool enabled              (Read)
+ *      Apply the register writes of the channels
+ *
+ *  Remarks
+ *    The steps and the writes to $4017 are taken in the order of
+ *    their clocks, and the writes to the channels before each of
+ *    them are applied first. So a write resetting a counter and a
+ *    step clocking it keep their order in the line.
+ */
+  const struct ApuEventQueue_t &q = ApuEventQueue[APU_QUEUE_FRAME];
+  int events[APU_QUEUE_MAX] = {};
+  int event = 0;
+
+  ApuCtrlNew = ApuCtrl;
+
+  for (;;)
+  {
+    const struct ApuFrameStep_t &step = ApuFrameSteps[ApuFrameMode][ApuFrameStep];
+    int time = step.clocks - ApuFrameClocks;
+
+    if (event < q.count && q.event[event].time <= time)
     {
-      ApuC4EnvVol = (ApuC4EnvVol - 1) & 0x0f;
+      // A write to $4017 restarts the sequence
+      time = q.event[event].time;
+      BYTE data = q.event[event++].data;
+      ApuWriteChannels(time, events, enabled);
+
+      ApuFrameMode = data >> 7;
+      ApuFrameInhibit = data & 0x40;
+      ApuFrameStep = 0;
+      ApuFrameClocks = -time;
+
+      // The 5-step sequence clocks the units at once
+      if (ApuFrameMode)
+        ApuFrameClock(APU_FRAME_QUARTER | APU_FRAME_HALF);
     }
-    else if (ApuC4EnvVol > 0)
+    else if (time < clocks)
     {
-      --ApuC4EnvVol;
+      ApuWriteChannels(time, events, enabled);
+      ApuFrameClock(step.flags);
+
+      if (++ApuFrameStep == ApuFrameStepCount[ApuFrameMode])
+      {
+        ApuFrameStep = 0;
+        ApuFrameClocks -= ApuFramePeriod[ApuFrameMode];
+      }
+    }
+    else
+    {
+      break;
     }
   }
-  // printf("C2: %02x %02x %02x %02x: %d %d\n", ApuC2a, ApuC2b, ApuC2c, ApuC2d, ApuC2Atl, ApuC2EnvVol);
-  // printf("C4: %02x  %02x %02x: %d %d\n", ApuC4a, ApuC4c, ApuC4d, ApuC4Atl, ApuC4EnvVol);
-  // printf("C5: %02x %02x %02x %02x, lp%d, v%02x, %04x, %d\n",
-  //        ApuC5Reg[0], ApuC5Reg[1], ApuC5Reg[2], ApuC5Reg[3],
-  //        ApuC5Looping, ApuC5DpcmValue, ApuC5Address, ApuC5DmaLength);
+
+  ApuWriteChannels(INT_MAX, events, enabled);
+  ApuFrameClocks += clocks;
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*      ApuRateControl() : Dynamic rate control per Vsync            */
+/*                                                                   */
+/*===================================================================*/
+
+/*-------------------------------------------------------------------*/
+/*  The samples per H-Sync are corrected in proportion to how far    */
+/*  the buffer of the system is from half full, averaged over the    */
+/*  frames, by up to APU_DRC_MAX. So the latency stays bounded and   */
+/*  the rate moves too slowly to be heard.                           */
+/*  The proportion alone would settle off half full by as much as    */
+/*  the clocks of the emulation and the display differ, so the       */
+/*  integral of the proportion takes that part over in time.         */
+/*-------------------------------------------------------------------*/
+
+#define APU_DRC_MAX 655    /* Largest correction ( 1% in 1 / 65536 ) */
+#define APU_DRC_AVERAGE 3  /* Frames averaged ( 1 << n ) */
+#define APU_DRC_INTEGRAL 7 /* Frames for the integral to reach the proportion ( 1 << n ) */
+
+static int ApuFillAverage16 = -1;
+static int ApuRateIntegral16; /* Integral part of the correction ( 1 / 65536 << 16 ) */
+static struct ApuStats_t ApuStats;
+
+static void ApuRateControl()
+{
+  int capacity = InfoNES_GetSoundBufferCapacity();
+  if (capacity <= 0)
+    return;
+
+  int fill = capacity - InfoNES_GetSoundBufferSize();
+
+  if (ApuFillAverage16 < 0)
+    ApuFillAverage16 = fill << 16;
+  else
+    ApuFillAverage16 += ((fill << 16) - ApuFillAverage16) >> APU_DRC_AVERAGE;
+
+  // Fewer samples above half full, more below
+  int error16 = ApuFillAverage16 - (capacity << 15);
+  int proportion16 = -(int)((int64_t)error16 * APU_DRC_MAX * 2 / capacity);
+
+  // The integral is limited as the correction is, so it does not wind up
+  ApuRateIntegral16 += proportion16 >> APU_DRC_INTEGRAL;
+  ApuRateIntegral16 = std::max(-(APU_DRC_MAX << 16), std::min(APU_DRC_MAX << 16, ApuRateIntegral16));
+
+  int correction = (proportion16 + ApuRateIntegral16) >> 16;
+  correction = std::max(-APU_DRC_MAX, std::min(APU_DRC_MAX, correction));
+
+  ApuSamplesPerSyncAdj16 = ((uint64_t)ApuSamplesPerSync16 * (65536 + correction)) >> 16;
+
+  ApuStats.nFill = fill;
+  ApuStats.nCapacity = capacity;
+  ApuStats.nCorrection = correction;
+}
+
+void InfoNES_pAPUGetStats(struct ApuStats_t *pStats)
+{
+  *pStats = ApuStats;
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*     InfoNES_pApuVsync() : Callback Function per Vsync             */
+/*                                                                   */
+/*===================================================================*/
+
+void InfoNES_pAPUVsync()
+{
+  ApuRateControl();
 }
 
 /*===================================================================*/
@@ -1161,13 +1933,27 @@ uint32_t leftSamples16 = 0;
 
 void __not_in_flash_func(InfoNES_pAPUHsync)(bool enabled)
 {
-  auto n16 = ApuSamplesPerSync16 + leftSamples16;
+  // Register writes and the frame sequencer over the CPU clocks of the line
+  ApuRunLine((WORD)(getCurrentClocks() - entertime), enabled);
+
+  auto n16 = ApuSamplesPerSyncAdj16 + leftSamples16;
   auto n = n16 >> 16;
   leftSamples16 = n16 - (n << 16);
 
   int bufferLeft = InfoNES_GetSoundBufferSize();
-  n = std::min<int>(bufferLeft, n);
+  if (bufferLeft >= InfoNES_GetSoundBufferCapacity())
+  {
+    // The system has played all the samples out
+    ++ApuStats.dwUnderruns;
+  }
+  else if (bufferLeft < (int)n)
+  {
+    // The samples which do not fit are dropped
+    ++ApuStats.dwOverruns;
+    n = std::max(bufferLeft, 0);
+  }
 
+#if APU_CHANNEL_BUFFERS
   if (enabled)
   {
     ApuRenderingWave1(n);
@@ -1189,9 +1975,15 @@ void __not_in_flash_func(InfoNES_pAPUHsync)(bool enabled)
   InfoNES_SoundOutput(n,
                       wave_buffers[0], wave_buffers[1], wave_buffers[2],
                       wave_buffers[3], wave_buffers[4]);
+#else
+  ApuRenderingMix(n, enabled);
+  if (enabled)
+    ApuCtrl = ApuCtrlNew;
+#endif
 
-  entertime = getPassedClocks();
-  cur_event = 0;
+  entertime = getCurrentClocks();
+  for (int ch = 0; ch < APU_QUEUE_MAX; ++ch)
+    ApuEventQueue[ch].count = 0;
 }
 
 /*===================================================================*/
@@ -1205,8 +1997,6 @@ void InfoNES_pAPUInit(void)
   /* Sound Hardware Init */
   InfoNES_SoundInit();
 
-  ApuQuality = pAPU_QUALITY - 1; // 1: 22050, 2: 44100 [samples/sec]
-
   ApuPulseMagic = ApuQual[ApuQuality].pulse_magic;
   ApuTriangleMagic = ApuQual[ApuQuality].triangle_magic;
   ApuNoiseMagic = ApuQual[ApuQuality].noise_magic;
@@ -1214,6 +2004,13 @@ void InfoNES_pAPUInit(void)
   ApuCyclesPerSample = ApuQual[ApuQuality].cycles_per_sample;
   ApuSampleRate = ApuQual[ApuQuality].sample_rate;
   ApuCycleRate = ApuQual[ApuQuality].cycle_rate;
+  ApuExtCycles16 = ((uint64_t)APU_CPU_CLOCK << 16) / ApuSampleRate;
+
+  // Start the rate control from the nominal rate
+  ApuSamplesPerSyncAdj16 = ApuSamplesPerSync16;
+  ApuFillAverage16 = -1;
+  ApuRateIntegral16 = 0;
+  ApuStats = {};
 
   InfoNES_SoundOpen((ApuSamplesPerSync16 + 65535) >> 16, ApuSampleRate);
 
@@ -1253,9 +2050,23 @@ void InfoNES_pAPUInit(void)
   ApuC5Reg[0] = ApuC5Reg[1] = ApuC5Reg[2] = ApuC5Reg[3] = 0;
   ApuC5Enable = ApuC5Looping = ApuC5CurByte = ApuC5DpcmValue = 0;
   ApuC5Freq = ApuC5Phaseacc;
-  ApuC5Address = ApuC5CacheAddr = 0;
+  // $4012 = 0 as the hardware starts
+  ApuC5Address = ApuC5CacheAddr = 0xC000;
   ApuC5DmaLength = ApuC5CacheDmaLength = 0;
+  ApuC5Page = NULL;
 
+  /*-------------------------------------------------------------------*/
+  /*   Initialize Frame Sequencer                                      */
+  /*-------------------------------------------------------------------*/
+  ApuFrameMode = ApuFrameInhibit = ApuFrameIrq = ApuFrameStep = 0;
+  ApuFrameClocks = 0;
+
+  /*-------------------------------------------------------------------*/
+  /*   Detach Expansion Sound ( the mapper attaches its own )          */
+  /*-------------------------------------------------------------------*/
+  InfoNES_pAPUSetExtSound(NULL);
+
+#if APU_CHANNEL_BUFFERS
   /*-------------------------------------------------------------------*/
   /*   Initialize Wave Buffers                                         */
   /*-------------------------------------------------------------------*/
@@ -1264,9 +2075,17 @@ void InfoNES_pAPUInit(void)
   InfoNES_MemorySet((void *)wave_buffers[2], 0, 735);
   InfoNES_MemorySet((void *)wave_buffers[3], 0, 735);
   InfoNES_MemorySet((void *)wave_buffers[4], 0, 735);
+#endif
+
+  entertime = getCurrentClocks();
+  for (int ch = 0; ch < APU_QUEUE_MAX; ++ch)
+    ApuEventQueue[ch].count = 0;
+  ApuEventOverflows = 0;
 
-  entertime = getPassedClocks();
-  cur_event = 0;
+  ApuMixInit();
+#if !APU_CHANNEL_BUFFERS
+  ApuBlipInit();
+#endif
 }
 
 /*===================================================================*/
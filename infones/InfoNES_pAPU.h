@@ -60,7 +60,7 @@
 /* Reg3: 0-2=high freq, 7-4=vbl length counter                       */
 /*-------------------------------------------------------------------*/
 #define ApuC3Holdnote (ApuC3a & 0x80)
-#define ApuC3LinearLength (((WORD)ApuC3a & 0x7f) << 6)
+#define ApuC3LinearLength (ApuC3a & 0x7f)
 #define ApuC3LengthCounter (ApuAtl[((ApuC3d & 0xf8) >> 3)])
 #define ApuC3Freq ((((WORD)ApuC3d & 0x07) << 8) + ApuC3c)
 
@@ -79,7 +79,7 @@
 #define ApuC4Freq (ApuNoiseFreq[(ApuC4c & 0x0f)])
 #define ApuC4Small (ApuC4c & 0x80)
 //#define ApuC4LengthCounter  ( ApuAtl[ ( ( ApuC4d & 0xf8 ) >> 3 ) ] )
-#define ApuC4LengthCounter (ApuAtl[(ApuC4d >> 3)] << 1)
+#define ApuC4LengthCounter (ApuAtl[(ApuC4d >> 3)])
 
 /*-------------------------------------------------------------------*/
 /* DPCM Channel                                                      */
@@ -101,7 +101,14 @@
 /*-------------------------------------------------------------------*/
 
 //#define APU_EVENT_MAX 15000
-#define APU_EVENT_MAX 100
+/* Register writes per channel in a scanline ( 113 clocks ) */
+#define APU_EVENT_MAX 32
+#define APU_CHANNEL_MAX 5
+
+/* The channels, the frame counter ( $4017 ) and the expansion sound */
+#define APU_QUEUE_FRAME APU_CHANNEL_MAX
+#define APU_QUEUE_EXT (APU_CHANNEL_MAX + 1)
+#define APU_QUEUE_MAX (APU_CHANNEL_MAX + 2)
 
 struct ApuEvent_t
 {
@@ -110,6 +117,18 @@ struct ApuEvent_t
   BYTE data;
 };
 
+/* Register writes to a channel since the last H-Sync */
+struct ApuEventQueue_t
+{
+  struct ApuEvent_t event[APU_EVENT_MAX];
+  int count;
+};
+
+extern struct ApuEventQueue_t ApuEventQueue[APU_QUEUE_MAX];
+
+/* Number of writes dropped as their queue was full */
+extern DWORD ApuEventOverflows;
+
 #define APUET_MASK 0xfc
 #define APUET_C1 0x00
 #define APUET_W_C1A 0x00
@@ -137,6 +156,7 @@ struct ApuEvent_t
 #define APUET_W_C5C 0x12
 #define APUET_W_C5D 0x13
 #define APUET_W_CTRL 0x20
+#define APUET_W_FRAME 0x30
 #define APUET_SYNC 0x40
 
 /*-------------------------------------------------------------------*/
@@ -151,24 +171,112 @@ void ApuWriteControl(WORD addr, BYTE value);
     ApuWriteControl(addr, value);             \
   }
 
+void ApuWriteFrameCounter(WORD addr, BYTE value);
+
+#define InfoNES_pAPUWriteFrameCounter(addr, value) \
+  {                                                \
+    ApuWriteFrameCounter(addr, value);             \
+  }
+
 void InfoNES_pAPUInit(void);
 void InfoNES_pAPUDone(void);
 void InfoNES_pAPUVsync(void);
 void InfoNES_pAPUHsync(bool enabled);
 
+/*-------------------------------------------------------------------*/
+/*  Mixer                                                            */
+/*  Amplitudes are pulse #1, #2, triangle, noise ( 0 - 15 ) and      */
+/*  dmc ( 0 - 127 ). A channel is panned by the volumes of the left  */
+/*  and right sides, APU_PAN_UNIT is through.                        */
+/*-------------------------------------------------------------------*/
+#define APU_PAN_UNIT 16
+
+#define APU_MIX_SCALE 10000 /* Output of the full mix */
+
+void InfoNES_pAPUMix(const BYTE *pbyAmp, short *pnLeft, short *pnRight);
+void InfoNES_pAPUSetPan(int ch, BYTE byLeft, BYTE byRight);
+
+/*-------------------------------------------------------------------*/
+/*  Expansion sound                                                  */
+/*  The mapper attaches the sound chip of the cartridge at its init  */
+/*  and passes the writes to the registers of the chip, which are    */
+/*  queued and applied in the order of the CPU clocks. The output of */
+/*  the chip in the scale of APU_MIX_SCALE is added to the mix.      */
+/*  A chip declares the channels it updates per sample, a chip over  */
+/*  APU_EXT_BUDGET is rendered once every few samples to stay in it. */
+/*  APU_EXT_SOUND = 0 leaves the chips silent.                       */
+/*-------------------------------------------------------------------*/
+#ifndef APU_EXT_SOUND
+#define APU_EXT_SOUND 1
+#endif
+
+#ifndef APU_EXT_BUDGET
+#define APU_EXT_BUDGET 4
+#endif
+
+struct ApuExtSound_t
+{
+  BYTE byCost;                            /* Channels updated per sample */
+  void (*Reset)();                        /* Reset the chip */
+  void (*Write)(BYTE byReg, BYTE byData); /* Write to a register of the chip */
+  int (*Render)(int nSamples);            /* Advance by the samples, returns the output */
+};
+
+/* CPU clocks per sample [16.16] */
+extern DWORD ApuExtCycles16;
+
+void InfoNES_pAPUSetExtSound(const struct ApuExtSound_t *pSound);
+void InfoNES_pAPUExtWrite(BYTE byReg, BYTE byData);
+
 /*-------------------------------------------------------------------*/
 /*  pAPU Quality resources                                           */
 /*-------------------------------------------------------------------*/
 
 /*-------------------------------------------------------------------*/
 /* ApuQuality is used to control the sound playback rate.            */
-/* 1 is 11015 Hz.                                                    */
-/* 2 is 22050 Hz.                                                    */
-/* 3 is 44100 Hz.                                                    */
+/* 1 is 32000 Hz.                                                    */
+/* 2 is 44100 Hz.                                                    */
+/* 3 is 48000 Hz.                                                    */
+/* pAPU_QUALITY is the default, InfoNES_pAPUSetSampleRate() selects  */
+/* one by the rate before InfoNES_Reset(). ( false if unsupported )  */
 /* these values subject to change without notice.                    */
 /*-------------------------------------------------------------------*/
 extern int ApuQuality;
-#define pAPU_QUALITY 3
+#define pAPU_QUALITY 2
+
+bool InfoNES_pAPUSetSampleRate(unsigned int nRate);
+
+/*-------------------------------------------------------------------*/
+/*  Dynamic rate control                                             */
+/*  The samples per H-Sync are corrected every V-Sync to keep the    */
+/*  buffer of the system half full.                                  */
+/*  nCorrection is the proportional and the integral part together.  */
+/*-------------------------------------------------------------------*/
+struct ApuStats_t
+{
+  int nFill;         /* Samples in the buffer at the last V-Sync */
+  int nCapacity;     /* Samples the buffer holds */
+  int nCorrection;   /* Correction of the rate ( 1 / 65536 ) */
+  DWORD dwUnderruns; /* H-Syncs finding the buffer empty */
+  DWORD dwOverruns;  /* H-Syncs dropping samples for the buffer full */
+};
+
+void InfoNES_pAPUGetStats(struct ApuStats_t *pStats);
+
+/*-------------------------------------------------------------------*/
+/* APU_CHANNEL_BUFFERS renders each channel to wave_buffers and      */
+/* mixes them in InfoNES_SoundOutput(), for debugging the channels.  */
+/* Otherwise the channels are mixed to the samples of the system     */
+/* in a single pass.                                                 */
+/*-------------------------------------------------------------------*/
+#ifndef APU_CHANNEL_BUFFERS
+#define APU_CHANNEL_BUFFERS 0
+#endif
+
+/* The expansion sound is only added to the single pass */
+#if APU_CHANNEL_BUFFERS && APU_EXT_SOUND
+#error "APU_CHANNEL_BUFFERS does not render the expansion sound, build it with APU_EXT_SOUND=0"
+#endif
 
 /*-------------------------------------------------------------------*/
 /*  Rectangle Wave #1 resources                                      */
@@ -196,6 +304,16 @@ extern DWORD ApuC3Llc; /* Linear Length Counter */
 
 extern BYTE ApuC4Atl;
 
+/* Length counter of the register ( in half frames ) */
+extern BYTE ApuAtl[0x20];
+
+/*-------------------------------------------------------------------*/
+/*  Frame sequencer resources                                        */
+/*  The frame interrupt is raised by the sequencer in H-Sync         */
+/*-------------------------------------------------------------------*/
+
+extern BYTE ApuFrameIrq;
+
 #endif /* InfoNES_PAPU_H_INCLUDED */
 
 /*
@@ -0,0 +1,479 @@
+/*===================================================================*/
+/*                                                                   */
+/*  InfoNES_pAPUExt.cpp : Expansion sound chips of the cartridges    */
+/*                                                                   */
+/*===================================================================*/
+
+/*-------------------------------------------------------------------*/
+/*  Include files                                                    */
+/*-------------------------------------------------------------------*/
+#include "InfoNES_pAPUExt.h"
+#include <math.h>
+#include <string.h>
+#include <pico.h>
+
+/*-------------------------------------------------------------------*/
+/*  Timer                                                            */
+/*  A timer counts the steps of a channel by samples in 16.16 as the */
+/*  magic numbers of the built-in channels do.                       */
+/*-------------------------------------------------------------------*/
+
+struct ApuExtTimer_t
+{
+  DWORD skip; /* Steps per sample [16.16] */
+  DWORD acc;  /* Fraction of the step */
+};
+
+static inline void ApuExtSetPeriod(struct ApuExtTimer_t &t, DWORD dwClocks)
+{
+  t.skip = ApuExtCycles16 / dwClocks;
+}
+
+/* Returns the steps in the samples */
+static inline int ApuExtAdvance(struct ApuExtTimer_t &t, int nSamples)
+{
+  t.acc += t.skip * nSamples;
+  int steps = t.acc >> 16;
+  t.acc &= 0xffff;
+  return steps;
+}
+
+/* Output of a volume step of a pulse, near to the one of the APU */
+#define APU_EXT_PULSE_STEP 75
+
+/*===================================================================*/
+/*                                                                   */
+/*                    Konami VRC6 : 2 pulses + saw                   */
+/*                                                                   */
+/*===================================================================*/
+
+static BYTE ApuVRC6Reg[12];
+static struct ApuExtTimer_t ApuVRC6Timer[3];
+static BYTE ApuVRC6Step[3];
+
+static void ApuVRC6Reset()
+{
+  memset(ApuVRC6Reg, 0, sizeof ApuVRC6Reg);
+  memset(ApuVRC6Timer, 0, sizeof ApuVRC6Timer);
+  memset(ApuVRC6Step, 0, sizeof ApuVRC6Step);
+  for (int ch = 0; ch < 3; ++ch)
+    ApuExtSetPeriod(ApuVRC6Timer[ch], 1);
+}
+
+static void __not_in_flash_func(ApuVRC6Write)(BYTE byReg, BYTE byData)
+{
+  if (byReg >= sizeof ApuVRC6Reg)
+    return;
+  ApuVRC6Reg[byReg] = byData;
+
+  int ch = byReg >> 2;
+  const BYTE *reg = &ApuVRC6Reg[ch << 2];
+  ApuExtSetPeriod(ApuVRC6Timer[ch], (((reg[2] & 0x0f) << 8) | reg[1]) + 1);
+
+  // The phase is reset while the channel is disabled
+  if (!(reg[2] & 0x80))
+    ApuVRC6Step[ch] = 0;
+}
+
+static int __not_in_flash_func(ApuVRC6Render)(int nSamples)
+{
+  int out = 0;
+
+  /* Pulses : 16 steps, high while the step is in the duty */
+  for (int ch = 0; ch < 2; ++ch)
+  {
+    const BYTE *reg = &ApuVRC6Reg[ch << 2];
+    if (!(reg[2] & 0x80))
+      continue;
+
+    ApuVRC6Step[ch] = (ApuVRC6Step[ch] + ApuExtAdvance(ApuVRC6Timer[ch], nSamples)) & 0x0f;
+    if ((reg[0] & 0x80) || ApuVRC6Step[ch] <= ((reg[0] >> 4) & 0x07))
+      out += reg[0] & 0x0f;
+  }
+
+  /* Saw : the rate is accumulated every 2 of 14 steps */
+  const BYTE *reg = &ApuVRC6Reg[8];
+  if (reg[2] & 0x80)
+  {
+    ApuVRC6Step[2] = (ApuVRC6Step[2] + ApuExtAdvance(ApuVRC6Timer[2], nSamples)) % 14;
+    out += (((reg[0] & 0x3f) * (ApuVRC6Step[2] >> 1)) & 0xff) >> 3;
+  }
+
+  return out * APU_EXT_PULSE_STEP;
+}
+
+const struct ApuExtSound_t ApuExtVRC6 = {3, ApuVRC6Reset, ApuVRC6Write, ApuVRC6Render};
+
+/*===================================================================*/
+/*                                                                   */
+/*                Namco 163 : 1 - 8 wavetable channels               */
+/*                                                                   */
+/*===================================================================*/
+
+/*
+ *  The registers of a channel are in the top of the sound RAM.
+ *    +0 +2 +4 : Frequency ( 18 bits )
+ *    +1 +3 +5 : Phase ( 24 bits, the sample in the top 8 bits )
+ *    +4       : Length of the wave ( 256 - bits 2-7 )
+ *    +6       : Address of the wave ( in 4 bit samples )
+ *    +7       : Volume ( 0 - 15 ), channels - 1 in bits 4-6 of $7F
+ *
+ *  The chip serves one channel every 15 CPU clocks and outputs it
+ *  until the next, so each channel is heard for 1 / channels of the
+ *  time. The mean of the outputs is given here.
+ */
+
+#define APU_N163_CLOCKS 15
+
+static BYTE ApuN163Ram[0x80];
+static int ApuN163Out[8];
+static int ApuN163Sum;
+static int ApuN163Channels;
+static int ApuN163Slot;
+static DWORD ApuN163Clocks16;
+
+static void ApuN163Reset()
+{
+  memset(ApuN163Ram, 0, sizeof ApuN163Ram);
+  memset(ApuN163Out, 0, sizeof ApuN163Out);
+  ApuN163Sum = 0;
+  ApuN163Channels = 1;
+  ApuN163Slot = 7;
+  ApuN163Clocks16 = 0;
+}
+
+static void __not_in_flash_func(ApuN163Write)(BYTE byReg, BYTE byData)
+{
+  byReg &= 0x7f;
+  ApuN163Ram[byReg] = byData;
+
+  if (byReg == 0x7f)
+  {
+    ApuN163Channels = ((byData >> 4) & 0x07) + 1;
+
+    // The channels left out are silent
+    for (int ch = 0; ch < 8 - ApuN163Channels; ++ch)
+    {
+      ApuN163Sum -= ApuN163Out[ch];
+      ApuN163Out[ch] = 0;
+    }
+    if (ApuN163Slot < 8 - ApuN163Channels)
+      ApuN163Slot = 7;
+  }
+}
+
+static inline void ApuN163Serve(int ch)
+{
+  BYTE *reg = &ApuN163Ram[0x40 + (ch << 3)];
+
+  DWORD freq = ((reg[4] & 0x03) << 16) | (reg[2] << 8) | reg[0];
+  DWORD phase = (reg[5] << 16) | (reg[3] << 8) | reg[1];
+  DWORD length = (256 - (reg[4] & 0xfc)) << 16;
+
+  phase = (phase + freq) % length;
+  reg[5] = phase >> 16;
+  reg[3] = phase >> 8;
+  reg[1] = phase;
+
+  // 2 samples in a byte, the low nibble first
+  BYTE addr = reg[6] + (phase >> 16);
+  int sample = (ApuN163Ram[(addr >> 1) & 0x7f] >> ((addr & 1) << 2)) & 0x0f;
+  int out = (sample - 8) * (reg[7] & 0x0f);
+
+  ApuN163Sum += out - ApuN163Out[ch];
+  ApuN163Out[ch] = out;
+}
+
+static int __not_in_flash_func(ApuN163Render)(int nSamples)
+{
+  ApuN163Clocks16 += ApuExtCycles16 * nSamples;
+  while (ApuN163Clocks16 >= (APU_N163_CLOCKS << 16))
+  {
+    ApuN163Clocks16 -= APU_N163_CLOCKS << 16;
+    ApuN163Serve(ApuN163Slot);
+
+    // The slots go down from channel 7
+    if (--ApuN163Slot < 8 - ApuN163Channels)
+      ApuN163Slot = 7;
+  }
+
+  return ApuN163Sum * 12 / ApuN163Channels;
+}
+
+const struct ApuExtSound_t ApuExtN163 = {4, ApuN163Reset, ApuN163Write, ApuN163Render};
+
+/*===================================================================*/
+/*                                                                   */
+/*          Sunsoft 5B : 3 tones with a noise and an envelope        */
+/*                                                                   */
+/*===================================================================*/
+
+/*
+ *  The tones toggle every 16 * period and the noise steps every
+ *  32 * period CPU clocks. The envelope has 32 levels of 1.5 dB
+ *  stepping every 16 * period clocks. A fixed volume v is the level
+ *  2 * v + 1 of the envelope.
+ */
+
+#define APU_5B_FULL 1500 /* Output of a channel at the full level */
+
+static BYTE Apu5BReg[0x10];
+static struct ApuExtTimer_t Apu5BTone[3];
+static struct ApuExtTimer_t Apu5BNoise;
+static struct ApuExtTimer_t Apu5BEnv;
+static BYTE Apu5BToneOut[3];
+static DWORD Apu5BLfsr;
+static int Apu5BEnvCount;
+static int Apu5BEnvAttack;
+static bool Apu5BEnvHold;
+static WORD Apu5BLevel[32];
+
+static void Apu5BReset()
+{
+  memset(Apu5BReg, 0, sizeof Apu5BReg);
+  memset(Apu5BToneOut, 0, sizeof Apu5BToneOut);
+  for (int ch = 0; ch < 3; ++ch)
+    ApuExtSetPeriod(Apu5BTone[ch], 16);
+  ApuExtSetPeriod(Apu5BNoise, 32);
+  ApuExtSetPeriod(Apu5BEnv, 16);
+  Apu5BLfsr = 1;
+  Apu5BEnvCount = 0x1f;
+  Apu5BEnvAttack = 0;
+  Apu5BEnvHold = true;
+
+  Apu5BLevel[0] = 0;
+  for (int i = 1; i < 32; ++i)
+    Apu5BLevel[i] = (WORD)(APU_5B_FULL * pow(10.0, (i - 31) * 1.5 / 20) + 0.5);
+}
+
+static void __not_in_flash_func(Apu5BWrite)(BYTE byReg, BYTE byData)
+{
+  byReg &= 0x0f;
+  Apu5BReg[byReg] = byData;
+
+  switch (byReg)
+  {
+  case 0x00:
+  case 0x01:
+  case 0x02:
+  case 0x03:
+  case 0x04:
+  case 0x05:
+  {
+    int ch = byReg >> 1;
+    int period = ((Apu5BReg[(ch << 1) + 1] & 0x0f) << 8) | Apu5BReg[ch << 1];
+    ApuExtSetPeriod(Apu5BTone[ch], (period ? period : 1) << 4);
+  }
+  break;
+
+  case 0x06:
+    ApuExtSetPeriod(Apu5BNoise, ((byData & 0x1f) ? (byData & 0x1f) : 1) << 5);
+    break;
+
+  case 0x0b:
+  case 0x0c:
+  {
+    int period = (Apu5BReg[0x0c] << 8) | Apu5BReg[0x0b];
+    ApuExtSetPeriod(Apu5BEnv, (period ? period : 1) << 4);
+  }
+  break;
+
+  case 0x0d:
+    /* Restart the envelope by the shape */
+    Apu5BEnvCount = 0x1f;
+    Apu5BEnvAttack = (byData & 0x04) ? 0x1f : 0;
+    Apu5BEnvHold = false;
+    Apu5BEnv.acc = 0;
+    break;
+  }
+}
+
+static inline void Apu5BEnvStep()
+{
+  if (--Apu5BEnvCount >= 0)
+    return;
+
+  BYTE shape = Apu5BReg[0x0d];
+  if (!(shape & 0x08))
+  {
+    // Falls to 0 after a cycle
+    Apu5BEnvAttack = 0;
+    Apu5BEnvHold = true;
+    Apu5BEnvCount = 0;
+    return;
+  }
+
+  if (shape & 0x02)
+    Apu5BEnvAttack ^= 0x1f;
+  if (shape & 0x01)
+  {
+    Apu5BEnvHold = true;
+    Apu5BEnvCount = 0;
+  }
+  else
+    Apu5BEnvCount = 0x1f;
+}
+
+static int __not_in_flash_func(Apu5BRender)(int nSamples)
+{
+  for (int ch = 0; ch < 3; ++ch)
+    Apu5BToneOut[ch] ^= ApuExtAdvance(Apu5BTone[ch], nSamples) & 1;
+
+  for (int steps = ApuExtAdvance(Apu5BNoise, nSamples); steps > 0; --steps)
+    Apu5BLfsr = (Apu5BLfsr >> 1) | (((Apu5BLfsr ^ (Apu5BLfsr >> 3)) & 1) << 16);
+
+  int envSteps = ApuExtAdvance(Apu5BEnv, nSamples);
+  for (; envSteps > 0 && !Apu5BEnvHold; --envSteps)
+    Apu5BEnvStep();
+  int envLevel = Apu5BEnvCount ^ Apu5BEnvAttack;
+
+  BYTE mixer = Apu5BReg[0x07];
+  int out = 0;
+  for (int ch = 0; ch < 3; ++ch)
+  {
+    // A disabled tone or noise holds the output high
+    bool tone = Apu5BToneOut[ch] || (mixer & (0x01 << ch));
+    bool noise = (Apu5BLfsr & 1) || (mixer & (0x08 << ch));
+    if (!tone || !noise)
+      continue;
+
+    BYTE vol = Apu5BReg[0x08 + ch];
+    if (vol & 0x10)
+      out += Apu5BLevel[envLevel];
+    else if (vol & 0x0f)
+      out += Apu5BLevel[((vol & 0x0f) << 1) + 1];
+  }
+
+  return out;
+}
+
+const struct ApuExtSound_t ApuExt5B = {5, Apu5BReset, Apu5BWrite, Apu5BRender};
+
+/*===================================================================*/
+/*                                                                   */
+/*                   Nintendo MMC5 : 2 pulses + PCM                  */
+/*                                                                   */
+/*===================================================================*/
+
+/*
+ *  The pulses are the ones of the APU without the sweeps. The
+ *  envelopes and the length counters are clocked at 240 Hz. The PCM
+ *  is given by the raw writes to $5011, the read mode is not
+ *  emulated.
+ */
+
+#define APU_MMC5_QUARTER 7457 /* CPU clocks of 240 Hz */
+#define APU_MMC5_PCM_STEP 8   /* Output of a step of the PCM */
+
+struct ApuMMC5Pulse_t
+{
+  struct ApuExtTimer_t timer;
+  BYTE step;
+  BYTE length;
+  BYTE decay;
+  BYTE divider;
+  bool start;
+};
+
+static BYTE ApuMMC5Reg[0x16];
+static struct ApuMMC5Pulse_t ApuMMC5Pulse[2];
+static DWORD ApuMMC5Clocks16;
+
+/* Steps of the 8 high in the duty */
+static const BYTE ApuMMC5Duty[4] = {1, 2, 4, 6};
+
+static void ApuMMC5Reset()
+{
+  memset(ApuMMC5Reg, 0, sizeof ApuMMC5Reg);
+  memset(ApuMMC5Pulse, 0, sizeof ApuMMC5Pulse);
+  for (int ch = 0; ch < 2; ++ch)
+    ApuExtSetPeriod(ApuMMC5Pulse[ch].timer, 2);
+  ApuMMC5Clocks16 = 0;
+}
+
+static void __not_in_flash_func(ApuMMC5Write)(BYTE byReg, BYTE byData)
+{
+  if (byReg >= sizeof ApuMMC5Reg)
+    return;
+
+  // A raw write of 0 is ignored by the PCM
+  if (byReg == 0x11 && ((ApuMMC5Reg[0x10] & 0x01) || !byData))
+    return;
+  ApuMMC5Reg[byReg] = byData;
+
+  if (byReg < 0x08)
+  {
+    struct ApuMMC5Pulse_t &p = ApuMMC5Pulse[byReg >> 2];
+    const BYTE *reg = &ApuMMC5Reg[byReg & 0x04];
+    ApuExtSetPeriod(p.timer, ((((reg[3] & 0x07) << 8) | reg[2]) + 1) << 1);
+
+    if ((byReg & 0x03) == 0x03)
+    {
+      if (ApuMMC5Reg[0x15] & (0x01 << (byReg >> 2)))
+        p.length = ApuAtl[byData >> 3];
+      p.start = true;
+      p.step = 0;
+    }
+  }
+  else if (byReg == 0x15)
+  {
+    for (int ch = 0; ch < 2; ++ch)
+      if (!(byData & (0x01 << ch)))
+        ApuMMC5Pulse[ch].length = 0;
+  }
+}
+
+static inline void ApuMMC5Quarter()
+{
+  for (int ch = 0; ch < 2; ++ch)
+  {
+    struct ApuMMC5Pulse_t &p = ApuMMC5Pulse[ch];
+    BYTE ctrl = ApuMMC5Reg[ch << 2];
+
+    if (p.start)
+    {
+      p.start = false;
+      p.decay = 15;
+      p.divider = ctrl & 0x0f;
+    }
+    else if (p.divider)
+      p.divider--;
+    else
+    {
+      p.divider = ctrl & 0x0f;
+      if (p.decay)
+        p.decay--;
+      else if (ctrl & 0x20)
+        p.decay = 15;
+    }
+
+    // Bit 5 halts the length counter
+    if (p.length && !(ctrl & 0x20))
+      p.length--;
+  }
+}
+
+static int __not_in_flash_func(ApuMMC5Render)(int nSamples)
+{
+  ApuMMC5Clocks16 += ApuExtCycles16 * nSamples;
+  while (ApuMMC5Clocks16 >= (APU_MMC5_QUARTER << 16))
+  {
+    ApuMMC5Clocks16 -= APU_MMC5_QUARTER << 16;
+    ApuMMC5Quarter();
+  }
+
+  int out = 0;
+  for (int ch = 0; ch < 2; ++ch)
+  {
+    struct ApuMMC5Pulse_t &p = ApuMMC5Pulse[ch];
+    p.step = (p.step + ApuExtAdvance(p.timer, nSamples)) & 0x07;
+
+    BYTE ctrl = ApuMMC5Reg[ch << 2];
+    if (p.length && p.step < ApuMMC5Duty[ctrl >> 6])
+      out += (ctrl & 0x10) ? (ctrl & 0x0f) : p.decay;
+  }
+
+  return out * APU_EXT_PULSE_STEP + ApuMMC5Reg[0x11] * APU_MMC5_PCM_STEP;
+}
+
+const struct ApuExtSound_t ApuExtMMC5 = {2, ApuMMC5Reset, ApuMMC5Write, ApuMMC5Render};
@@ -0,0 +1,37 @@
+/*===================================================================*/
+/*                                                                   */
+/*  InfoNES_pAPUExt.h : Expansion sound chips of the cartridges      */
+/*                                                                   */
+/*===================================================================*/
+
+#ifndef InfoNES_PAPUEXT_H_INCLUDED
+#define InfoNES_PAPUEXT_H_INCLUDED
+
+/*-------------------------------------------------------------------*/
+/*  Include files                                                    */
+/*-------------------------------------------------------------------*/
+
+#include "InfoNES_Types.h"
+#include "InfoNES_pAPU.h"
+
+/*-------------------------------------------------------------------*/
+/*  Sound chips                                                      */
+/*  The registers are numbered as the mapper passes the writes.      */
+/*                                                                   */
+/*  ApuExtVRC6 : Konami VRC6 ( Mapper 24, 26 )                       */
+/*               $9000-$9002 : 0-2, $A000-$A002 : 4-6,               */
+/*               $B000-$B002 : 8-10                                  */
+/*  ApuExtN163 : Namco 163 ( Mapper 19 )                             */
+/*               Sound RAM : 0x00-0x7f                               */
+/*  ApuExt5B   : Sunsoft 5B ( Mapper 69 )                            */
+/*               Register selected by $C000 : 0x00-0x0f              */
+/*  ApuExtMMC5 : Nintendo MMC5 ( Mapper 5, with MAPPER_MMC5 )        */
+/*               $5000-$5015 : 0x00-0x15                             */
+/*-------------------------------------------------------------------*/
+
+extern const struct ApuExtSound_t ApuExtVRC6;
+extern const struct ApuExtSound_t ApuExtN163;
+extern const struct ApuExtSound_t ApuExt5B;
+extern const struct ApuExtSound_t ApuExtMMC5;
+
+#endif /* !InfoNES_PAPUEXT_H_INCLUDED */
@@ -246,11 +246,19 @@ BYTE NMI_Wiring;
 int g_wPassedClocks;
 int g_wCurrentClocks;
 
+// g_wCurrentClocks - g_wPassedClocks at the start of step()
+int g_wStepBaseClocks;
+
 WORD getPassedClocks()
 {
   return g_wCurrentClocks;
 }
 
+WORD __not_in_flash_func(getCurrentClocks)()
+{
+  return g_wStepBaseClocks + g_wPassedClocks;
+}
+
 // A table for the test
 BYTE g_byTestTable[256];
 
@@ -409,6 +417,7 @@ void K6502_Reset()
   // Reset Passed Clocks
   g_wPassedClocks = 0;
   g_wCurrentClocks = 0;
+  g_wStepBaseClocks = 0;
 }
 
 /*===================================================================*/
@@ -482,6 +491,7 @@ static void __not_in_flash_func(step)(int wClocks)
   WORD wD0;
 
   auto prePassedClocks = g_wPassedClocks;
+  g_wStepBaseClocks = g_wCurrentClocks - prePassedClocks;
 
   // It has a loop until a constant clock passes
   while (g_wPassedClocks < wClocks)
@@ -944,8 +954,35 @@ static void __not_in_flash_func(step)(int wClocks)
       break;
 
     case 0x8D: // STA Abs
-      STA(AA_ABS);
+      wA0 = AA_ABS;
+      STA(wA0);
       CLK(4);
+
+      // A tight loop filling PPU memory ( STA $2007 / DEX or DEY / BNE )
+      if (wA0 == 0x2007 && K6502_Read(PC + 1) == 0xD0 && K6502_Read(PC + 2) == 0xFA)
+      {
+        byD0 = K6502_Read(PC);
+        if (byD0 == 0xCA || byD0 == 0x88)
+        {
+          BYTE &byCnt = (byD0 == 0xCA) ? X : Y;
+
+          // A turn is DEX 2 + BNE 3 ( + 1 across a page ) + STA 4 clocks
+          // ( the branch is taken from PC + 3 back to the STA at PC - 3 )
+          wD0 = PC + 3;
+          int nTurnClocks = 9 + ((wD0 & 0x0100) != ((wD0 - 6) & 0x0100));
+          int nTurns = (wClocks - g_wPassedClocks) / nTurnClocks;
+          if (nTurns > (BYTE)(byCnt - 1))
+            nTurns = (BYTE)(byCnt - 1);
+
+          // The rest of the loop is left to the instructions
+          if (nTurns > 0)
+          {
+            nTurns = K6502_BurstVram(A, nTurns);
+            byCnt -= nTurns;
+            CLK(nTurns * nTurnClocks);
+          }
+        }
+      }
       break;
 
     case 0x8E: // STX Abs
@@ -1369,6 +1406,7 @@ static void __not_in_flash_func(step)(int wClocks)
   // Correct the number of the clocks
   g_wCurrentClocks += (g_wPassedClocks - prePassedClocks);
   g_wPassedClocks -= wClocks;
+  g_wStepBaseClocks = g_wCurrentClocks - g_wPassedClocks;
 }
 
 /*===================================================================*/
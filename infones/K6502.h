@@ -68,6 +68,8 @@ static inline BYTE K6502_ReadIY();
 
 static inline void K6502_Write(WORD wAddr, BYTE byData);
 static inline void K6502_WriteW(WORD wAddr, WORD wData);
+static inline void K6502_WriteVram(BYTE byData);
+static inline int K6502_BurstVram(BYTE byData, int nCount);
 
 // The state of the IRQ pin
 extern BYTE IRQ_State;
@@ -80,5 +82,7 @@ extern WORD PC;
 // The number of the clocks that it passed
 //extern WORD g_wPassedClocks;
 WORD getPassedClocks();
+// Same as getPassedClocks(), but also counts in the middle of K6502_Step()
+WORD getCurrentClocks();
 
 #endif /* !K6502_H_INCLUDED */
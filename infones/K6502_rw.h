@@ -79,6 +79,7 @@ static inline BYTE __not_in_flash_func(K6502_Read)(WORD wAddr)
     return RAM[wAddr & 0x7ff];
 
   case 0x2000:                /* PPU */
+    InfoNES_DotSync();
     if ((wAddr & 0x7) == 0x7) /* PPU Memory */
     {
       WORD addr = PPU_Addr;
@@ -90,8 +91,13 @@ static inline BYTE __not_in_flash_func(K6502_Read)(WORD wAddr)
       // Set return value;
       byRet = PPU_R7;
 
-      // Read PPU Memory
-      PPU_R7 = PPUBANK[addr >> 10][addr & 0x3ff];
+      // Read PPU Memory ( 0x3000 - 0x3eff are the mirror of 0x2000 - 0x2eff )
+      if (addr >= 0x3f00)
+      {
+        // Palette is read without the buffer ( the backdrop is kept at 0x00 )
+        byRet = PPU_PalRam[(addr & 3) ? addr & 0x1f : 0];
+      }
+      PPU_R7 = PPUBANK[(addr & 0x2fff) >> 10][addr & 0x3ff];
 
       return byRet;
     }
@@ -125,7 +131,7 @@ static inline BYTE __not_in_flash_func(K6502_Read)(WORD wAddr)
     if (wAddr == 0x4015)
     {
       // APU control
-      byRet = APU_Reg[0x4015];
+      byRet = ApuFrameIrq;
       if (ApuC1Atl > 0)
         byRet |= (1 << 0);
       if (ApuC2Atl > 0)
@@ -144,7 +150,7 @@ static inline BYTE __not_in_flash_func(K6502_Read)(WORD wAddr)
         byRet |= (1 << 3);
 
       // FrameIRQ
-      APU_Reg[0x4015] &= ~0x40;
+      ApuFrameIrq = 0;
       return byRet;
     }
     else if (wAddr == 0x4016)
@@ -232,9 +238,11 @@ static inline void __not_in_flash_func(K6502_Write)(WORD wAddr, BYTE byData)
   break;
 
   case 0x2000: /* PPU */
+    InfoNES_DotSync();
     switch (wAddr & 0x7)
     {
     case 0: /* 0x2000 */
+      InfoNES_SplitLine();
       PPU_R0 = byData;
       PPU_Increment = (PPU_R0 & R0_INC_ADDR) ? 32 : 1;
       PPU_NameTableBank = NAME_TABLE0 + (PPU_R0 & R0_NAME_ADDR);
@@ -247,6 +255,7 @@ static inline void __not_in_flash_func(K6502_Write)(WORD wAddr, BYTE byData)
       break;
 
     case 1: /* 0x2001 */
+      InfoNES_SplitLine();
       PPU_R1 = byData;
       break;
 
@@ -263,10 +272,13 @@ static inline void __not_in_flash_func(K6502_Write)(WORD wAddr, BYTE byData)
 
     case 4: /* 0x2004 */
       // Write data to Sprite RAM
+      InfoNES_SyncLines();
       SPRRAM[PPU_R3++] = byData;
       break;
 
     case 5: /* 0x2005 */
+      InfoNES_SplitLine();
+
       // Set Scroll Register
       if (PPU_Latch_Flag)
       {
@@ -294,6 +306,8 @@ static inline void __not_in_flash_func(K6502_Write)(WORD wAddr, BYTE byData)
       break;
 
     case 6: /* 0x2006 */
+      InfoNES_SplitLine();
+
       // Set PPU Address
       if (PPU_Latch_Flag)
       {
@@ -320,42 +334,8 @@ static inline void __not_in_flash_func(K6502_Write)(WORD wAddr, BYTE byData)
       break;
 
     case 7: /* 0x2007 */
-    {
-      WORD addr = PPU_Addr;
-
-      // Increment PPU Address
-      PPU_Addr += PPU_Increment;
-      addr &= 0x3fff;
-
-      // Write to PPU Memory
-      if (addr < 0x2000 && byVramWriteEnable)
-      {
-        // Pattern Data
-        ChrBufUpdate |= (1 << (addr >> 10));
-        PPUBANK[addr >> 10][addr & 0x3ff] = byData;
-      }
-      else if (addr < 0x3f00) /* 0x2000 - 0x3eff */
-      {
-        // Name Table and mirror
-        PPUBANK[addr >> 10][addr & 0x3ff] = byData;
-        PPUBANK[(addr ^ 0x1000) >> 10][addr & 0x3ff] = byData;
-      }
-      else if (!(addr & 0xf)) /* 0x3f00 or 0x3f10 */
-      {
-        // Palette mirror
-        PPURAM[0x3f10] = PPURAM[0x3f14] = PPURAM[0x3f18] = PPURAM[0x3f1c] =
-            PPURAM[0x3f00] = PPURAM[0x3f04] = PPURAM[0x3f08] = PPURAM[0x3f0c] = byData;
-        PalTable[0x00] = PalTable[0x04] = PalTable[0x08] = PalTable[0x0c] =
-            PalTable[0x10] = PalTable[0x14] = PalTable[0x18] = PalTable[0x1c] = NesPalette[byData] | 0x8000;
-      }
-      else if (addr & 3)
-      {
-        // Palette
-        PPURAM[addr] = byData;
-        PalTable[addr & 0x1f] = NesPalette[byData];
-      }
-    }
-    break;
+      K6502_WriteVram(byData);
+      break;
     }
     break;
 
@@ -389,6 +369,8 @@ static inline void __not_in_flash_func(K6502_Write)(WORD wAddr, BYTE byData)
 
     case 0x14: /* 0x4014 */
       // Sprite DMA
+      InfoNES_DotSync();
+      InfoNES_SyncLines();
       switch (byData >> 5)
       {
       case 0x0: /* RAM */
@@ -438,16 +420,8 @@ static inline void __not_in_flash_func(K6502_Write)(WORD wAddr, BYTE byData)
       break;
 
     case 0x17: /* 0x4017 */
-      // Frame IRQ
-      FrameStep = 0;
-      if (!(byData & 0xc0))
-      {
-        FrameIRQ_Enable = 1;
-      }
-      else
-      {
-        FrameIRQ_Enable = 0;
-      }
+      // Frame counter
+      InfoNES_pAPUWriteFrameCounter(wAddr, byData);
       break;
     }
 
@@ -478,12 +452,114 @@ static inline void __not_in_flash_func(K6502_Write)(WORD wAddr, BYTE byData)
   case 0xa000: /* ROM BANK 1 */
   case 0xc000: /* ROM BANK 2 */
   case 0xe000: /* ROM BANK 3 */
-    // Write to Mapper
+    // Write to Mapper ( may switch the banks of the PPU )
+    InfoNES_DotSync();
+    InfoNES_SplitLine();
     MapperWrite(wAddr, byData);
     break;
   }
 }
 
+/*===================================================================*/
+/*                                                                   */
+/*            K6502_WriteVram() : Writing to PPU memory              */
+/*                                                                   */
+/*===================================================================*/
+static inline void __not_in_flash_func(K6502_WriteVram)(BYTE byData)
+{
+  /*
+ *  Writing to PPU memory through 0x2007
+ *
+ *  Parameters
+ *    BYTE byData             (Read)
+ *      Data to write
+ *
+ *  Remarks
+ *    A palette write is a single store to PPU_PalRam. The backdrop
+ *    is kept at 0x00 for all its mirrors, and PalTable is packed from
+ *    the entries in PPU_PalDirty before the next scanline is drawn.
+ *    Name table and pattern writes wait for the queued scanlines.
+ */
+
+  WORD addr = PPU_Addr & 0x3fff;
+
+  // Increment PPU Address
+  PPU_Addr += PPU_Increment;
+
+  if (addr >= 0x3f00)
+  {
+    // Palette
+    if (addr & 3)
+    {
+      ++PPU_PalGen;
+      PPU_PalRam[addr & 0x1f] = byData;
+      PPU_PalDirty |= 1u << (addr & 0x1f);
+    }
+    else if (!(addr & 0xf)) /* 0x3f00 or 0x3f10 */
+    {
+      ++PPU_PalGen;
+      PPU_PalRam[0x00] = byData;
+      PPU_PalDirty |= 0x11111111u;
+    }
+  }
+  else if (addr >= 0x2000)
+  {
+    // Name Table ( 0x3000 - 0x3eff are the mirror )
+    addr &= 0x2fff;
+    InfoNES_SyncLines();
+    BYTE *pbyPage = PPUBANK[addr >> 10];
+    ++PPU_VRAMROWGEN(pbyPage, addr);
+    pbyPage[addr & 0x3ff] = byData;
+
+    // Attribute table
+    if ((addr & 0x3c0) == 0x3c0)
+      InfoNES_WriteAttr(pbyPage, addr & 0x3f, byData);
+  }
+  else if (byVramWriteEnable)
+  {
+    // Pattern Data
+    InfoNES_SyncLines();
+    ChrBufUpdate |= (1 << (addr >> 10));
+    ++PPU_ChrGen;
+    PPUBANK[addr >> 10][addr & 0x3ff] = byData;
+  }
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*        K6502_BurstVram() : Repeated writes to PPU memory          */
+/*                                                                   */
+/*===================================================================*/
+static inline int __not_in_flash_func(K6502_BurstVram)(BYTE byData, int nCount)
+{
+  /*
+ *  Write the same data to PPU memory through 0x2007 repeatedly
+ *
+ *  Parameters
+ *    BYTE byData             (Read)
+ *      Data to write
+ *
+ *    int nCount              (Read)
+ *      The number of writes
+ *
+ *  Return values
+ *    The number of writes done ( 0 : The CPU has to write one by one )
+ *
+ *  Remarks
+ *    The writes share the clock, so they are done only while the PPU
+ *    does not render: rendering is off or in V-Blank, and the dot
+ *    engine is not used.
+ */
+
+  if (PPU_DotEngine ||
+      ((PPU_R1 & (R1_SHOW_SCR | R1_SHOW_SP)) && PPU_Scanline < SCAN_VBLANK_START))
+    return 0;
+
+  for (int nIdx = 0; nIdx < nCount; ++nIdx)
+    K6502_WriteVram(byData);
+  return nCount;
+}
+
 // Reading/Writing operation (WORD version)
 static inline WORD K6502_ReadW(WORD wAddr) { return K6502_Read(wAddr) | (WORD)K6502_Read(wAddr + 1) << 8; };
 static inline void K6502_WriteW(WORD wAddr, WORD wData)
@@ -20,6 +20,9 @@ BYTE Map4_IRQ_Request;
 BYTE Map4_IRQ_Present;
 BYTE Map4_IRQ_Present_Vbl;
 
+/* A12 of the last pattern fetch ( Dot engine ) */
+BYTE Map4_A12;
+
 /*-------------------------------------------------------------------*/
 /*  Initialize Mapper 4                                              */
 /*-------------------------------------------------------------------*/
@@ -46,8 +49,8 @@ void Map4_Init()
   /* Callback at HSync */
   MapperHSync = Map4_HSync;
 
-  /* Callback at PPU */
-  MapperPPU = Map0_PPU;
+  /* Callback at PPU ( the dot engine passes the pattern fetches ) */
+  MapperPPU = PPU_DotEngine ? Map4_PPU : Map0_PPU;
 
   /* Callback at Rendering Screen ( 1:BG, 0:Sprite ) */
   MapperRenderScreen = Map0_RenderScreen;
@@ -88,6 +91,7 @@ void Map4_Init()
   Map4_IRQ_Request = 0;
   Map4_IRQ_Present = 0;
   Map4_IRQ_Present_Vbl = 0;
+  Map4_A12 = 0;
 
   /* Set up wiring of the interrupt pin */
   K6502_Set_Int_Wiring( 1, 1 ); 
@@ -203,7 +207,8 @@ void Map4_Write( WORD wAddr, BYTE byData )
 
     case 0xc001:
       Map4_Regs[ 5 ] = byData;
-      if ( PPU_Scanline < 240 )
+      /* The dot engine clocks the pre-render line and reloads there */
+      if ( PPU_Scanline < 240 || PPU_DotEngine )
       {
           Map4_IRQ_Cnt |= 0x80;
           Map4_IRQ_Present = 0xff;
@@ -237,9 +242,51 @@ void Map4_HSync()
  *  Callback at HSync
  *
  */
-  if ( ( 0 <= PPU_Scanline && PPU_Scanline <= 239 ) && 
+  /* The dot engine clocks the counter by A12 in Map4_PPU() */
+  if ( !PPU_DotEngine &&
+       ( 0 <= PPU_Scanline && PPU_Scanline <= 239 ) && 
        ( PPU_R1 & R1_SHOW_SCR || PPU_R1 & R1_SHOW_SP ) )
   {
+    Map4_Clock();
+	}
+	if( Map4_IRQ_Request  ) {
+		IRQ_REQ;
+	}
+}
+
+/*-------------------------------------------------------------------*/
+/*  Mapper 4 PPU Function                                            */
+/*-------------------------------------------------------------------*/
+void Map4_PPU( WORD wAddr )
+{
+/*
+ *  Callback at PPU ( Dot engine )
+ *
+ *  Remarks
+ *    The counter is clocked at a rising edge of A12 between the
+ *    pattern fetches. The name table fetches are not passed, so no
+ *    filter of the short edges is needed.
+ */
+  BYTE byA12 = ( wAddr & 0x1000 ) ? 1 : 0;
+  if ( byA12 && !Map4_A12 )
+  {
+    Map4_Clock();
+    if( Map4_IRQ_Request  ) {
+      IRQ_REQ;
+    }
+  }
+  Map4_A12 = byA12;
+}
+
+/*-------------------------------------------------------------------*/
+/*  Mapper 4 Clock IRQ Counter Function                              */
+/*-------------------------------------------------------------------*/
+void Map4_Clock()
+{
+/*
+ *  Clock the IRQ counter
+ *
+ */
 		if( Map4_IRQ_Present_Vbl ) {
 			Map4_IRQ_Cnt = Map4_IRQ_Latch;
 			Map4_IRQ_Present_Vbl = 0;
@@ -257,10 +304,6 @@ void Map4_HSync()
 			}
 			Map4_IRQ_Present = 0xFF;
 		}
-	}
-	if( Map4_IRQ_Request  ) {
-		IRQ_REQ;
-	}
 }
 
 /*-------------------------------------------------------------------*/
@@ -106,6 +106,9 @@ void Map5_Init()
   Map5_IRQ_Status = 0;
   Map5_IRQ_Line = 0;
 
+  /* Initialize Extra Sound */
+  InfoNES_pAPUSetExtSound(&ApuExtMMC5);
+
   /* Set up wiring of the interrupt pin */
   K6502_Set_Int_Wiring(1, 1);
 }
@@ -281,6 +284,7 @@ void Map5_Apu(WORD wAddr, BYTE byData)
     if (0x5000 <= wAddr && wAddr <= 0x5015)
     {
       /* Extra Sound */
+      InfoNES_pAPUExtWrite(wAddr - 0x5000, byData);
     }
     else if (0x5c00 <= wAddr && wAddr <= 0x5fff)
     {
@@ -10,6 +10,10 @@ BYTE Map19_Regs[2];
 BYTE Map19_IRQ_Enable;
 DWORD Map19_IRQ_Cnt;
 
+/* Sound RAM read back through $4800, the chip keeps its own */
+BYTE Map19_Sound_Ram[0x80];
+BYTE Map19_Sound_Addr;
+
 /* The address of 1Kbytes unit of the Map19 Chr RAM */
 #define Map19_VROMPAGE(a) &Map19_Chr_Ram[(a)*0x400]
 
@@ -74,6 +78,11 @@ void Map19_Init()
   Map19_Regs[1] = 0x00;
   Map19_Regs[2] = 0x00;
 
+  /* Initialize Extra Sound */
+  InfoNES_MemorySet(Map19_Sound_Ram, 0x00, sizeof(Map19_Sound_Ram));
+  Map19_Sound_Addr = 0x00;
+  InfoNES_pAPUSetExtSound(&ApuExtN163);
+
   /* Set up wiring of the interrupt pin */
   K6502_Set_Int_Wiring(1, 1);
 }
@@ -262,7 +271,8 @@ void Map19_Write(WORD wAddr, BYTE byData)
   case 0xf800: /* $e800-efff */
     if (wAddr == 0xf800)
     {
-      // Extra Sound
+      /* Extra Sound : address of the sound RAM, auto increment by bit 7 */
+      Map19_Sound_Addr = byData;
     }
     break;
   }
@@ -278,7 +288,12 @@ void Map19_Apu(WORD wAddr, BYTE byData)
   case 0x4800:
     if (wAddr == 0x4800)
     {
-      // Extra Sound
+      /* Extra Sound */
+      BYTE byAddr = Map19_Sound_Addr & 0x7f;
+      Map19_Sound_Ram[byAddr] = byData;
+      InfoNES_pAPUExtWrite(byAddr, byData);
+      if (Map19_Sound_Addr & 0x80)
+        Map19_Sound_Addr = 0x80 | ((Map19_Sound_Addr + 1) & 0x7f);
     }
     break;
 
@@ -303,7 +318,11 @@ BYTE Map19_ReadApu(WORD wAddr)
   case 0x4800:
     if (wAddr == 0x4800)
     {
-      // Extra Sound
+      /* Extra Sound */
+      BYTE byData = Map19_Sound_Ram[Map19_Sound_Addr & 0x7f];
+      if (Map19_Sound_Addr & 0x80)
+        Map19_Sound_Addr = 0x80 | ((Map19_Sound_Addr + 1) & 0x7f);
+      return byData;
     }
     return (BYTE)(wAddr >> 8);
 
@@ -49,6 +49,9 @@ void Map24_Init()
   ROMBANK2 = ROMLASTPAGE( 1 );
   ROMBANK3 = ROMLASTPAGE( 0 );
 
+  /* Initialize Extra Sound */
+  InfoNES_pAPUSetExtSound( &ApuExtVRC6 );
+
   /* Set up wiring of the interrupt pin */
   K6502_Set_Int_Wiring( 1, 1 ); 
 }
@@ -66,6 +69,19 @@ void Map24_Write( WORD wAddr, BYTE byData )
       ROMBANK1 = ROMPAGE( ( byData + 1 ) % ( NesHeader.byRomSize << 1) );
       break;
 
+    /* Extra Sound */
+    case 0x9000:
+    case 0x9001:
+    case 0x9002:
+    case 0xa000:
+    case 0xa001:
+    case 0xa002:
+    case 0xb000:
+    case 0xb001:
+    case 0xb002:
+      InfoNES_pAPUExtWrite( ( ( ( wAddr >> 12 ) - 9 ) << 2 ) | ( wAddr & 0x03 ), byData );
+      break;
+
     case 0xb003:
       /* Name Table Mirroring */
       switch ( byData & 0x0c )
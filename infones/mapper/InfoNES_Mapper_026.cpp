@@ -61,6 +61,9 @@ void Map26_Init()
   Map26_IRQ_Enable = 0;
   Map26_IRQ_Cnt = 0;
 
+  /* Initialize Extra Sound */
+  InfoNES_pAPUSetExtSound( &ApuExtVRC6 );
+
   /* Set up wiring of the interrupt pin */
   K6502_Set_Int_Wiring( 1, 1 ); 
 }
@@ -81,6 +84,19 @@ void Map26_Write( WORD wAddr, BYTE byData )
       ROMBANK1 = ROMPAGE( byData + 1 );
       break;
 
+    /* Extra Sound ( A0 and A1 are swapped ) */
+    case 0x9000:
+    case 0x9001:
+    case 0x9002:
+    case 0xa000:
+    case 0xa001:
+    case 0xa002:
+    case 0xb000:
+    case 0xb001:
+    case 0xb002:
+      InfoNES_pAPUExtWrite( ( ( ( wAddr >> 12 ) - 9 ) << 2 ) | ( ( wAddr & 0x01 ) << 1 ) | ( ( wAddr & 0x02 ) >> 1 ), byData );
+      break;
+
     /* Name Table Mirroring */
     case 0xb003:  
       switch ( byData & 0x7f )
@@ -7,6 +7,7 @@
 BYTE  Map69_IRQ_Enable;
 DWORD Map69_IRQ_Cnt;
 BYTE  Map69_Regs[ 1 ];
+BYTE  Map69_Sound_Reg;
 
 /*-------------------------------------------------------------------*/
 /*  Initialize Mapper 69                                             */
@@ -61,6 +62,10 @@ void Map69_Init()
   Map69_IRQ_Enable = 0;
   Map69_IRQ_Cnt    = 0;
 
+  /* Initialize Extra Sound */
+  Map69_Sound_Reg = 0;
+  InfoNES_pAPUSetExtSound( &ApuExt5B );
+
   /* Set up wiring of the interrupt pin */
   K6502_Set_Int_Wiring( 1, 1 ); 
 }
@@ -151,6 +156,15 @@ void Map69_Write( WORD wAddr, BYTE byData )
           break;
       }
       break;
+
+    /* Extra Sound */
+    case 0xC000:
+      Map69_Sound_Reg = byData & 0x0f;
+      break;
+
+    case 0xE000:
+      InfoNES_pAPUExtWrite( Map69_Sound_Reg, byData );
+      break;
   }
 }
 
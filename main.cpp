@@ -37,10 +37,69 @@ const uint LED_PIN = PICO_DEFAULT_LED_PIN;
 #define DVICONFIG dviConfig_PicoDVISock
 #endif
 
+// 前フレームのラインを保持して変化のないラインの描画を省く (120KB 使う, INDEX_LINE_BUFFER なら 60KB)
+#ifndef LINE_CACHE
+#define LINE_CACHE 0
+#endif
+
+// NES の色番号 (8bit) でラインを描画し, RGB への変換を core1 で行う
+// (PIXEL_FORMATS に PIXEL_INDEX8 が必要. CMakeLists.txt 参照)
+#ifndef INDEX_LINE_BUFFER
+#define INDEX_LINE_BUFFER 0
+#endif
+
+// core0 は各ラインの PPU の状態だけを記録し, ラインの描画は core1 で行う
+#ifndef LINE_PIPELINE
+#define LINE_PIPELINE 0
+#endif
+
+// 処理が表示に間に合わないときに次のフレームの描画を省く
+#ifndef AUTO_FRAME_SKIP
+#define AUTO_FRAME_SKIP 0
+#endif
+
+// 音声の出力サンプリングレート (32000, 44100, 48000)
+#ifndef AUDIO_SAMPLE_RATE
+#define AUDIO_SAMPLE_RATE 44100
+#endif
+
+#if INDEX_LINE_BUFFER && !(PIXEL_FORMATS & (1 << PIXEL_INDEX8))
+#error "INDEX_LINE_BUFFER needs PIXEL_INDEX8 in PIXEL_FORMATS"
+#endif
+
+#if LINE_PIPELINE && INDEX_LINE_BUFFER
+#error "LINE_PIPELINE and INDEX_LINE_BUFFER can not be used together"
+#endif
+
 namespace
 {
     constexpr uint32_t CPUFreqKHz = 252000;
 
+    // 640x480p60 の 1 フレームの時間 [us] (800x525 ドット, ピクセルクロックは CPU クロックの 1/10)
+    // 切り上げておき, 表示に合っている間は遅れが溜まらないようにする
+    constexpr uint32_t DisplayFrameTimeUS = (800ull * 525 * 10 * 1000 + CPUFreqKHz - 1) / CPUFreqKHz;
+
+    // HDMI の Audio Clock Regeneration: 128 * fs = f_TMDS * N / CTS
+    // N は HDMI 仕様の推奨値, TMDS クロックは CPU クロックの 1/10
+    constexpr uint32_t getAudioN(uint32_t fs)
+    {
+        return fs == 32000 ? 4096 : fs == 44100 ? 6272 : fs == 48000 ? 6144 : 0;
+    }
+
+    constexpr uint32_t getAudioCTS(uint32_t fs)
+    {
+        return static_cast<uint64_t>(CPUFreqKHz / 10) * 1000 * getAudioN(fs) / (128 * fs);
+    }
+
+    static_assert(getAudioN(AUDIO_SAMPLE_RATE), "AUDIO_SAMPLE_RATE must be 32000, 44100 or 48000");
+    static_assert(static_cast<uint64_t>(CPUFreqKHz / 10) * 1000 * getAudioN(AUDIO_SAMPLE_RATE) %
+                          (128 * AUDIO_SAMPLE_RATE) ==
+                      0,
+                  "CTS is not an integer");
+
+    // 音声リングバッファのサンプル数 (1 つは空きとして残る)
+    constexpr int AudioBufferSize = 256;
+
     constexpr dvi::Config dviConfig_PicoDVI = {
         .pinTMDS = {10, 12, 14},
         .pinClock = 8,
@@ -103,16 +162,16 @@ namespace
     }
 }
 
-#define CC(x) (((x >> 1) & 15) | (((x >> 6) & 15) << 4) | (((x >> 11) & 15) << 8))
+// RGB555 (InfoNES_SetPixelFormat() で 12bpp に変換)
 const WORD __not_in_flash_func(NesPalette)[64] = {
-    CC(0x39ce), CC(0x1071), CC(0x0015), CC(0x2013), CC(0x440e), CC(0x5402), CC(0x5000), CC(0x3c20),
-    CC(0x20a0), CC(0x0100), CC(0x0140), CC(0x00e2), CC(0x0ceb), CC(0x0000), CC(0x0000), CC(0x0000),
-    CC(0x5ef7), CC(0x01dd), CC(0x10fd), CC(0x401e), CC(0x5c17), CC(0x700b), CC(0x6ca0), CC(0x6521),
-    CC(0x45c0), CC(0x0240), CC(0x02a0), CC(0x0247), CC(0x0211), CC(0x0000), CC(0x0000), CC(0x0000),
-    CC(0x7fff), CC(0x1eff), CC(0x2e5f), CC(0x223f), CC(0x79ff), CC(0x7dd6), CC(0x7dcc), CC(0x7e67),
-    CC(0x7ae7), CC(0x4342), CC(0x2769), CC(0x2ff3), CC(0x03bb), CC(0x0000), CC(0x0000), CC(0x0000),
-    CC(0x7fff), CC(0x579f), CC(0x635f), CC(0x6b3f), CC(0x7f1f), CC(0x7f1b), CC(0x7ef6), CC(0x7f75),
-    CC(0x7f94), CC(0x73f4), CC(0x57d7), CC(0x5bf9), CC(0x4ffe), CC(0x0000), CC(0x0000), CC(0x0000)};
+    0x39ce, 0x1071, 0x0015, 0x2013, 0x440e, 0x5402, 0x5000, 0x3c20,
+    0x20a0, 0x0100, 0x0140, 0x00e2, 0x0ceb, 0x0000, 0x0000, 0x0000,
+    0x5ef7, 0x01dd, 0x10fd, 0x401e, 0x5c17, 0x700b, 0x6ca0, 0x6521,
+    0x45c0, 0x0240, 0x02a0, 0x0247, 0x0211, 0x0000, 0x0000, 0x0000,
+    0x7fff, 0x1eff, 0x2e5f, 0x223f, 0x79ff, 0x7dd6, 0x7dcc, 0x7e67,
+    0x7ae7, 0x4342, 0x2769, 0x2ff3, 0x03bb, 0x0000, 0x0000, 0x0000,
+    0x7fff, 0x579f, 0x635f, 0x6b3f, 0x7f1f, 0x7f1b, 0x7ef6, 0x7f75,
+    0x7f94, 0x73f4, 0x57d7, 0x5bf9, 0x4ffe, 0x0000, 0x0000, 0x0000};
 
 uint32_t getCurrentNVRAMAddr()
 {
@@ -320,6 +379,11 @@ int __not_in_flash_func(InfoNES_GetSoundBufferSize)()
     return dvi_->getAudioRingBuffer().getFullWritableSize();
 }
 
+int __not_in_flash_func(InfoNES_GetSoundBufferCapacity)()
+{
+    return AudioBufferSize - 1;
+}
+
 void __not_in_flash_func(InfoNES_SoundOutput)(int samples, BYTE *wave1, BYTE *wave2, BYTE *wave3, BYTE *wave4, BYTE *wave5)
 {
     while (samples)
@@ -335,26 +399,17 @@ void __not_in_flash_func(InfoNES_SoundOutput)(int samples, BYTE *wave1, BYTE *wa
         int ct = n;
         while (ct--)
         {
-            int w1 = *wave1++;
-            int w2 = *wave2++;
-            int w3 = *wave3++;
-            int w4 = *wave4++;
-            int w5 = *wave5++;
-            //            w3 = w2 = w4 = w5 = 0;
-            int l = w1 * 6 + w2 * 3 + w3 * 5 + w4 * 3 * 17 + w5 * 2 * 32;
-            int r = w1 * 3 + w2 * 6 + w3 * 5 + w4 * 3 * 17 + w5 * 2 * 32;
-            *p++ = {static_cast<short>(l), static_cast<short>(r)};
-
-            // pulse_out = 0.00752 * (pulse1 + pulse2)
-            // tnd_out = 0.00851 * triangle + 0.00494 * noise + 0.00335 * dmc
-
-            // 0.00851/0.00752 = 1.131648936170213
-            // 0.00494/0.00752 = 0.6569148936170213
-            // 0.00335/0.00752 = 0.4454787234042554
-
-            // 0.00752/0.00851 = 0.8836662749706228
-            // 0.00494/0.00851 = 0.5804935370152762
-            // 0.00335/0.00851 = 0.3936545240893067
+            // 各チャンネルのネイティブな振幅にして APU のミキサーを通す
+            const BYTE amp[5] = {
+                static_cast<BYTE>(*wave1++ >> 4),
+                static_cast<BYTE>(*wave2++ >> 4),
+                static_cast<BYTE>(*wave3++ >> 4),
+                *wave4++,
+                static_cast<BYTE>(*wave5++ * 2),
+            };
+            short l, r;
+            InfoNES_pAPUMix(amp, &l, &r);
+            *p++ = {l, r};
         }
 
         ring.advanceWritePointer(n);
@@ -362,6 +417,24 @@ void __not_in_flash_func(InfoNES_SoundOutput)(int samples, BYTE *wave1, BYTE *wa
     }
 }
 
+int __not_in_flash_func(InfoNES_SoundLockSamples)(short **ppSamples, int samples)
+{
+    auto &ring = dvi_->getAudioRingBuffer();
+    // L, R の short が並んだサンプル
+    *ppSamples = reinterpret_cast<short *>(ring.getWritePointer());
+    return std::min<int>(samples, ring.getWritableSize());
+}
+
+void __not_in_flash_func(InfoNES_SoundUnlockSamples)(int samples)
+{
+    dvi_->getAudioRingBuffer().advanceWritePointer(samples);
+}
+
+DWORD __not_in_flash_func(InfoNES_GetMicroSec)()
+{
+    return time_us_32();
+}
+
 extern WORD PC;
 
 void InfoNES_LoadFrame()
@@ -375,6 +448,173 @@ void InfoNES_LoadFrame()
 namespace
 {
     dvi::DVI::LineBuffer *currentLineBuffer_{};
+
+#if INDEX_LINE_BUFFER
+    using LinePixel = BYTE;
+
+    // core0 が描画して core1 が変換するライン
+    struct IndexLine
+    {
+        int line;
+        BYTE emphasis; // R1 の強調ビット (モノクロは PalTable で処理済み)
+        dvi::DVI::LineBuffer *lineBuffer;
+        LinePixel pixels[NES_DISP_WIDTH];
+    };
+
+    constexpr uint32_t INDEX_LINE_COUNT = 4;
+    IndexLine indexLines_[INDEX_LINE_COUNT];
+    volatile uint32_t indexLineWritePos_ = 0; // core0 だけが進める
+    volatile uint32_t indexLineReadPos_ = 0;  // core1 だけが進める
+    IndexLine *currentIndexLine_{};
+
+    // NES の色番号 -> RGB444 (強調ビットごと)
+    WORD indexPalette_[8][64];
+#else
+    using LinePixel = WORD;
+#endif
+
+#if LINE_PIPELINE
+    // core0 が記録して core1 が描画するライン
+    constexpr uint32_t PIPELINE_LINE_COUNT = 4;
+    PPU_Line_tag pipelineLines_[PIPELINE_LINE_COUNT];
+    volatile uint32_t pipelineWritePos_ = 0; // core0 だけが進める
+    volatile uint32_t pipelineReadPos_ = 0;  // core1 だけが進める
+#endif
+
+#if INDEX_LINE_BUFFER || LINE_PIPELINE
+    // DVI に渡したラインと変換したラインの数
+    // core1 が自分で作るラインを待って止まらないように, 変換待ちがあるときだけ変換する
+    volatile uint32_t core0ValidLines_ = 0; // core0 だけが進める
+    uint32_t core1ValidLines_ = 0;          // core1 だけが進める
+    uint32_t convertedLines_ = 0;           // core1 だけが進める
+
+    uint32_t __not_in_flash_func(getValidLineCount)()
+    {
+        return core0ValidLines_ + core1ValidLines_ - convertedLines_;
+    }
+#endif
+
+    LinePixel *__not_in_flash_func(getCurrentLinePixels)()
+    {
+#if INDEX_LINE_BUFFER
+        return currentIndexLine_->pixels;
+#else
+        return currentLineBuffer_->data() + 32;
+#endif
+    }
+
+#if LINE_CACHE
+    LinePixel lineCache_[NES_DISP_HEIGHT][NES_DISP_WIDTH];
+    bool lineReused_ = false;
+#endif
+}
+
+#if INDEX_LINE_BUFFER
+void initIndexPalette()
+{
+    for (int e = 0; e < 8; ++e)
+    {
+        for (int i = 0; i < 64; ++i)
+        {
+            indexPalette_[e][i] = PixelRGB444::pack(i, InfoNES_EmphasizeColor(NesPalette[i], e));
+        }
+    }
+}
+
+// core1: 描画済みのラインを RGB444 に変換して DVI に渡す
+void __not_in_flash_func(convertIndexLines)()
+{
+    while (indexLineReadPos_ != indexLineWritePos_)
+    {
+        __dmb();
+        auto &src = indexLines_[indexLineReadPos_ % INDEX_LINE_COUNT];
+
+        const auto pal = indexPalette_[src.emphasis];
+        auto dst = src.lineBuffer->data() + 32;
+        for (int i = 0; i < NES_DISP_WIDTH; ++i)
+        {
+            dst[i] = pal[src.pixels[i] & 0x3f];
+        }
+
+        dvi_->setLineBuffer(src.line, src.lineBuffer);
+        ++core1ValidLines_;
+
+        __dmb();
+        indexLineReadPos_ = indexLineReadPos_ + 1;
+    }
+}
+#endif
+
+#if LINE_PIPELINE
+// core1: 記録されたラインを 1 ライン描画して DVI に渡す
+// 空きバッファは core1 の変換でしか増えないので, 変換待ちのラインがないときだけ呼ぶ
+void __not_in_flash_func(renderPipelineLine)()
+{
+    if (pipelineReadPos_ == pipelineWritePos_)
+    {
+        return;
+    }
+
+    __dmb();
+    auto &rec = pipelineLines_[pipelineReadPos_ % PIPELINE_LINE_COUNT];
+
+    auto b = dvi_->getLineBuffer();
+    InfoNES_RenderLine(&rec, b->data() + 32);
+    dvi_->setLineBuffer(rec.wLine, b);
+    ++core1ValidLines_;
+
+    __dmb();
+    pipelineReadPos_ = pipelineReadPos_ + 1;
+}
+#endif
+
+#if INDEX_LINE_BUFFER || LINE_PIPELINE
+// core1: DVI に渡すラインを作る. 変換待ちのラインがあれば true
+bool __not_in_flash_func(produceValidLines)()
+{
+#if INDEX_LINE_BUFFER
+    convertIndexLines();
+#else
+    if (getValidLineCount() == 0)
+    {
+        renderPipelineLine();
+    }
+#endif
+    return getValidLineCount() != 0;
+}
+#endif
+
+PPU_Line_tag *__not_in_flash_func(InfoNES_GetLineRecord)([[maybe_unused]] int line)
+{
+#if LINE_PIPELINE
+    // core1 の描画待ち
+    while (pipelineWritePos_ - pipelineReadPos_ >= PIPELINE_LINE_COUNT)
+    {
+    }
+    return &pipelineLines_[pipelineWritePos_ % PIPELINE_LINE_COUNT];
+#else
+    return nullptr;
+#endif
+}
+
+void __not_in_flash_func(InfoNES_QueueLine)([[maybe_unused]] PPU_Line_tag *rec)
+{
+#if LINE_PIPELINE
+    // core1 に渡す
+    __dmb();
+    pipelineWritePos_ = pipelineWritePos_ + 1;
+#endif
+}
+
+void __not_in_flash_func(InfoNES_FlushLines)()
+{
+#if LINE_PIPELINE
+    // PPU のメモリが書き換わる前に core1 の描画を待つ
+    while (pipelineReadPos_ != pipelineWritePos_)
+    {
+    }
+    __dmb();
+#endif
 }
 
 void __not_in_flash_func(drawWorkMeterUnit)(int timing,
@@ -416,22 +656,67 @@ void __not_in_flash_func(InfoNES_PreDrawLine)(int line)
 {
     util::WorkMeterMark(0xaaaa);
     auto b = dvi_->getLineBuffer();
+#if INDEX_LINE_BUFFER
+    // core1 の変換待ち
+    while (indexLineWritePos_ - indexLineReadPos_ >= INDEX_LINE_COUNT)
+    {
+    }
+    currentIndexLine_ = &indexLines_[indexLineWritePos_ % INDEX_LINE_COUNT];
+    currentIndexLine_->lineBuffer = b;
+    util::WorkMeterMark(0x5555);
+    InfoNES_SetLineBuffer(currentIndexLine_->pixels, NES_DISP_WIDTH);
+#else
     util::WorkMeterMark(0x5555);
     InfoNES_SetLineBuffer(b->data() + 32, b->size());
     //    (*b)[319] = line + dvi_->getFrameCounter();
+#endif
 
     currentLineBuffer_ = b;
 }
 
+bool __not_in_flash_func(InfoNES_ReuseLine)(int line)
+{
+#if LINE_CACHE
+    memcpy(getCurrentLinePixels(), lineCache_[line], sizeof(lineCache_[line]));
+    lineReused_ = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
 void __not_in_flash_func(InfoNES_PostDrawLine)(int line)
 {
+#if LINE_CACHE
+    if (!lineReused_)
+    {
+        memcpy(lineCache_[line], getCurrentLinePixels(), sizeof(lineCache_[line]));
+    }
+    lineReused_ = false;
+#endif
+
 #if !defined(NDEBUG)
     util::WorkMeterMark(0xffff);
     drawWorkMeter(line);
 #endif
 
     assert(currentLineBuffer_);
+#if INDEX_LINE_BUFFER
+    currentIndexLine_->line = line;
+    currentIndexLine_->emphasis = PPU_ColorMode >> 5;
+    currentIndexLine_ = nullptr;
+
+    // core1 に渡す
+    __dmb();
+    indexLineWritePos_ = indexLineWritePos_ + 1;
+#else
     dvi_->setLineBuffer(line, currentLineBuffer_);
+#if LINE_PIPELINE
+    // パイプラインを使わない ROM では core0 が直接渡す
+    __dmb();
+    core0ValidLines_ = core0ValidLines_ + 1;
+#endif
+#endif
     currentLineBuffer_ = nullptr;
 }
 
@@ -472,11 +757,26 @@ void __not_in_flash_func(core1_main)()
     while (true)
     {
         dvi_->registerIRQThisCore();
+#if INDEX_LINE_BUFFER || LINE_PIPELINE
+        // 最初のラインは core1 が作るので, 作りながら待つ
+        while (!produceValidLines())
+        {
+        }
+#else
         dvi_->waitForValidLine();
+#endif
 
         dvi_->start();
         while (!exclProc_.isExist())
         {
+#if INDEX_LINE_BUFFER || LINE_PIPELINE
+            // 変換待ちのラインがなければ待たずに作る側に戻る
+            if (!produceValidLines())
+            {
+                continue;
+            }
+            ++convertedLines_;
+#endif
             if (scaleMode8_7_)
             {
                 dvi_->convertScanBuffer12bppScaled16_7(34, 32, 288 * 2);
@@ -554,9 +854,9 @@ int main()
     //
     dvi_ = std::make_unique<dvi::DVI>(pio0, &DVICONFIG,
                                       dvi::getTiming640x480p60Hz());
-    //    dvi_->setAudioFreq(48000, 25200, 6144);
-    dvi_->setAudioFreq(44100, 28000, 6272);
-    dvi_->allocateAudioBuffer(256);
+    dvi_->setAudioFreq(AUDIO_SAMPLE_RATE, getAudioCTS(AUDIO_SAMPLE_RATE), getAudioN(AUDIO_SAMPLE_RATE));
+    InfoNES_pAPUSetSampleRate(AUDIO_SAMPLE_RATE);
+    dvi_->allocateAudioBuffer(AudioBufferSize);
     //    dvi_->setExclusiveProc(&exclProc_);
 
     dvi_->getBlankSettings().top = 4 * 2;
@@ -565,8 +865,17 @@ int main()
 
     applyScreenMode();
 
-    // 空サンプル詰めとく
-    dvi_->getAudioRingBuffer().advanceWritePointer(255);
+    DirtyLine_Enable = LINE_CACHE;
+    LinePipeline_Enable = LINE_PIPELINE;
+#if INDEX_LINE_BUFFER
+    initIndexPalette();
+    InfoNES_SetPixelFormat(PIXEL_INDEX8);
+#endif
+    AutoFrameSkip = AUTO_FRAME_SKIP;
+    AutoSkipPeriod = DisplayFrameTimeUS;
+
+    // 空サンプル詰めとく (レート制御の目標の半分まで)
+    dvi_->getAudioRingBuffer().advanceWritePointer((AudioBufferSize - 1) / 2);
 
     multicore_launch_core1(core1_main);
 